@@ -124,6 +124,9 @@ bool FMatchmakingInterfacePlayFab::CreateMatchMakingTicket(const TArray< TShared
 	MatchmakingTicketPtr->SetHostUser(FirstUser);
 	MatchmakingTicketPtr->SearchingPlayerNetId = FUniqueNetIdPlayFab::Create(LocalPlayers[0].Get());
 
+	// Whoever ends up owning the arranged lobby hosts the network, get its creation out of the way while queued
+	OSSPlayFab->PrewarmPlayFabPartyNetwork();
+
 	return true;
 }
 
@@ -266,6 +269,11 @@ void FMatchmakingInterfacePlayFab::HandleMatchmakingTicketCompleted(const PFMatc
 		}
 	}
 
+	if (Ticket->MatchmakingState != EOnlinePlayFabMatchmakingState::MatchFound)
+	{
+		OSSPlayFab->DiscardMatchmakingPrewarmedPlayFabPartyNetwork(TEXT("ticket did not match"));
+	}
+
 	bool isTicketRemoved;
 	OnMatchmakingStatusChanged(SessionName, Ticket, isTicketRemoved);
 }
@@ -10,6 +10,8 @@
 
 #include "OnlineSubsystemPlayFab.h"
 #include "OnlineSubsystemPlayFabPrivate.h"
+#include "PlayFabBenchmark.h"
+#include "PlayFabStats.h"
 
 #include "GenericPlatform/GenericPlatformHttp.h"
 
@@ -31,6 +33,14 @@ FOnlineSessionPlayFab::FOnlineSessionPlayFab(class FOnlineSubsystemPlayFab* InSu
 #endif
 	RegisterForUpdates();
 	GenerateCrossNetworkVoiceChatPlatformPermissions();
+
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("JoinRetryInitialDelay"), JoinRetryInitialDelay, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("JoinRetryMaxDelay"), JoinRetryMaxDelay, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("JoinRetryJitter"), JoinRetryJitter, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("JoinRetryMaxCount"), JoinRetryMaxCount, GEngineIni);
+	JoinRetryInitialDelay = FMath::Max(JoinRetryInitialDelay, 0.0f);
+	JoinRetryMaxDelay = FMath::Max(JoinRetryMaxDelay, JoinRetryInitialDelay);
+	JoinRetryJitter = FMath::Clamp(JoinRetryJitter, 0.0f, 1.0f);
 }
 
 FOnlineSessionPlayFab::~FOnlineSessionPlayFab()
@@ -358,19 +368,21 @@ bool FOnlineSessionPlayFab::UpdateSession(FName SessionName, FOnlineSessionSetti
 		return false;
 	}
 
-	if (OnUpdateLobbyCompleteDelegate.IsValid())
+	// The lobby queues updates made while another is in progress and completes each call, so they are not rejected here
+	if (!OnUpdateLobbyCompleteDelegate.IsValid())
 	{
-		UE_LOG_ONLINE_SESSION(Warning, TEXT("FOnlineSessionPlayFab::UpdateSession: UpdateSession is already in progress. Call UpdateSession again after the current operation is completed."));
-		return false;
+		OnUpdateLobbyCompleteDelegate = OSSPlayFab->GetPlayFabLobbyInterface()->AddOnUpdateLobbyCompletedDelegate_Handle(FOnUpdateLobbyCompletedDelegate::CreateRaw(this, &FOnlineSessionPlayFab::OnUpdateLobbyCompleted));
 	}
-
-	OnUpdateLobbyCompleteDelegate = OSSPlayFab->GetPlayFabLobbyInterface()->AddOnUpdateLobbyCompletedDelegate_Handle(FOnUpdateLobbyCompletedDelegate::CreateRaw(this, &FOnlineSessionPlayFab::OnUpdateLobbyCompleted));
 	if (!OSSPlayFab->GetPlayFabLobbyInterface()->UpdateLobby(SessionName, UpdatedSessionSettings))
 	{
 		UE_LOG_ONLINE_SESSION(Verbose, TEXT("FOnlineSessionPlayFab::UpdateSession: Failed to update session %s"), *SessionName.ToString());
-		OSSPlayFab->GetPlayFabLobbyInterface()->ClearOnUpdateLobbyCompletedDelegate_Handle(OnUpdateLobbyCompleteDelegate);
+		if (PendingUpdateSessionCount == 0)
+		{
+			OSSPlayFab->GetPlayFabLobbyInterface()->ClearOnUpdateLobbyCompletedDelegate_Handle(OnUpdateLobbyCompleteDelegate);
+		}
 		return false;
 	}
+	PendingUpdateSessionCount++;
 
 	if (bUsesNativeSession)
 	{
@@ -592,7 +604,7 @@ void FOnlineSessionPlayFab::OnMatchmakingComplete(FName SessionName, bool bWasSu
 		else
 		{
 			//kick off the join logic and give time for the session update
-			RetryJoinMatchmakingSession_Count = RetryJoinMatchmakingSession_MaxCount;
+			ArmJoinNetworkRetry(RetryJoinMatchmakingSession);
 		}
 		// Matchmaking does not use native interface
 #if defined(USES_NATIVE_SESSION)
@@ -723,7 +735,8 @@ void FOnlineSessionPlayFab::OnCreatePartyEndpoint_Matchmaking(bool bSuccess, uin
 					SessionSettings->Set(SETTING_HOST_CONNECT_INFO, HostConnectInfo, EOnlineDataAdvertisementType::ViaOnlineService);
 
 					OnUpdateSession_MatchmakingDelegateHandle = OSSPlayFab->GetPlayFabLobbyInterface()->AddOnUpdateLobbyCompletedDelegate_Handle(FOnUpdateLobbyCompletedDelegate::CreateRaw(this, &FOnlineSessionPlayFab::OnUpdateSession_Matchmaking));
-					if (!OSSPlayFab->GetPlayFabLobbyInterface()->UpdateLobby(MatchmakingCompleteSessionName, *SessionSettings))
+					// Clients wait on the network descriptor to join, so it is not held back by lobby update pacing
+					if (!OSSPlayFab->GetPlayFabLobbyInterface()->UpdateLobby(MatchmakingCompleteSessionName, *SessionSettings, true))
 					{
 						UE_LOG_ONLINE_SESSION(Warning, TEXT("FOnlineSessionPlayFab::OnCreatePartyEndpoint_Matchmaking: Failed to update Lobby with network descriptor %s"), *MatchmakingCompleteSessionName.ToString());
 						OSSPlayFab->GetPlayFabLobbyInterface()->ClearOnUpdateLobbyCompletedDelegate_Handle(OnUpdateSession_MatchmakingDelegateHandle);
@@ -764,7 +777,11 @@ void FOnlineSessionPlayFab::OnCreatePartyEndpoint_JoinSession(bool bSuccess, uin
 void FOnlineSessionPlayFab::OnUpdateLobbyCompleted(FName SessionName, bool bWasSuccessful)
 {
 	UE_LOG_ONLINE_SESSION(Verbose, TEXT("FOnlineSessionPlayFab::OnUpdateLobbyCompleted()"));
-	OSSPlayFab->GetPlayFabLobbyInterface()->ClearOnUpdateLobbyCompletedDelegate_Handle(OnUpdateLobbyCompleteDelegate);
+	PendingUpdateSessionCount = FMath::Max(PendingUpdateSessionCount - 1, 0);
+	if (PendingUpdateSessionCount == 0)
+	{
+		OSSPlayFab->GetPlayFabLobbyInterface()->ClearOnUpdateLobbyCompletedDelegate_Handle(OnUpdateLobbyCompleteDelegate);
+	}
 	TriggerOnUpdateSessionCompleteDelegates(SessionName, bWasSuccessful);
 }
 
@@ -880,8 +897,14 @@ bool FOnlineSessionPlayFab::CancelFindSessions()
 
 bool FOnlineSessionPlayFab::PingSearchResults(const FOnlineSessionSearchResult& SearchResult)
 {
-	UE_LOG_ONLINE_SESSION(Display, TEXT("FOnlineSessionPlayFab::PingSearchResults: Not implemented"));
-	return false;
+	// There is no direct route to a lobby host before joining, the ping is estimated from the host's region instead
+	FPlayFabLobbyPtr PlayFabLobby = OSSPlayFab->GetPlayFabLobbyInterface();
+	if (!PlayFabLobby.IsValid() || !PlayFabLobby->PingSearchResult(SearchResult))
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("FOnlineSessionPlayFab::PingSearchResults: No latency estimate for session %s"), *SearchResult.GetSessionIdStr());
+		return false;
+	}
+	return true;
 }
 
 void FOnlineSessionPlayFab::RegisterForUpdates()
@@ -1010,18 +1033,7 @@ void FOnlineSessionPlayFab::OnLobbyUpdate(FName SessionName, const PFLobbyUpdate
 			if (SettingKey)
 			{
 				UE_LOG_ONLINE_SESSION(Verbose, TEXT("FOnlineSessionPlayFab::OnLobbyUpdate Search Key:%s, value:%s"), *FString(SettingKey->Key), *UpdatedSearchPropertyValue);
-				switch (SettingKey->Value)
-				{
-					case EOnlineKeyValuePairDataType::Bool:
-						ExistingNamedSession->SessionSettings.Set(FName(SettingKey->Key), *updatedSearchPropertyValue == '1' ? true : false, EOnlineDataAdvertisementType::ViaOnlineService);
-						break;
-					case EOnlineKeyValuePairDataType::Int32:
-						ExistingNamedSession->SessionSettings.Set(FName(SettingKey->Key), FCString::Atoi(*UpdatedSearchPropertyValue), EOnlineDataAdvertisementType::ViaOnlineService);
-						break;
-					case EOnlineKeyValuePairDataType::String:
-						ExistingNamedSession->SessionSettings.Set(FName(SettingKey->Key), UpdatedSearchPropertyValue, EOnlineDataAdvertisementType::ViaOnlineService);
-						break;
-				}
+				FPlayFabLobby::SetSessionSettingFromSearchProperty(ExistingNamedSession->SessionSettings, FName(SettingKey->Key), SettingKey->Value, updatedSearchPropertyValue);
 				if (IsHostSetting(FName(SettingKey->Key)))
 				{
 					UpdateHostSetting = true;
@@ -1126,6 +1138,16 @@ void FOnlineSessionPlayFab::OnLobbyUpdate(FName SessionName, const PFLobbyUpdate
 	SetMultiplayerActivityForSession(ExistingNamedSession);
 #endif
 
+	// The network id and descriptor arrive through lobby updates, so a pending join should look again right away
+	if (RetryJoinLobbySession.Count > 0 && SessionName == JoinSessionCompleteSessionName)
+	{
+		RetryJoinLobbySession.TimeUntilRetry = 0.0f;
+	}
+	if (RetryJoinMatchmakingSession.Count > 0 && SessionName == MatchmakingCompleteSessionName)
+	{
+		RetryJoinMatchmakingSession.TimeUntilRetry = 0.0f;
+	}
+
 	TriggerOnSessionSettingsUpdatedDelegates(SessionName, ExistingNamedSession->SessionSettings);
 }
 
@@ -1587,7 +1609,7 @@ void FOnlineSessionPlayFab::OnJoinLobbyCompleted(FName InSessionName, EOnJoinSes
 	JoinSessionCompleteSessionName = InSessionName;
 
 	//kick off the join logic and give time for the session update
-	RetryJoinLobbySession_Count = RetryJoinLobbySession_MaxCount;
+	ArmJoinNetworkRetry(RetryJoinLobbySession);
 
 	if (Result != EOnJoinSessionCompleteResult::Success && Result != EOnJoinSessionCompleteResult::AlreadyInSession)
 	{
@@ -2010,37 +2032,49 @@ const FName FOnlineSessionPlayFab::GetNativeSessionName() const
 	return NativeSessionName;
 }
 
-void FOnlineSessionPlayFab::Tick(float DeltaTime)
+void FOnlineSessionPlayFab::ArmJoinNetworkRetry(FJoinNetworkRetry& Retry)
 {
-	RetryJoinMatchmakingSession_TimeSinceLastRetry += DeltaTime;
+	Retry.Count = JoinRetryMaxCount;
+	Retry.Delay = JoinRetryInitialDelay;
+	Retry.TimeUntilRetry = 0.0f;
+}
 
-	if (RetryJoinMatchmakingSession_Count > 0)
+void FOnlineSessionPlayFab::TickJoinNetworkRetry(FJoinNetworkRetry& Retry, bool bJoinLobbyOperation, float DeltaTime)
+{
+	if (Retry.Count <= 0)
 	{
-		if (RetryJoinMatchmakingSession_TimeSinceLastRetry > RetryJoinMatchmakingSession_RetryTime)
-		{
-			RetryJoinMatchmakingSession_TimeSinceLastRetry = 0.0f;
-			RetryJoinMatchmakingSession_Count -= 1;
+		return;
+	}
 
-			OnOperationComplete_TryJoinNetwork(false, RetryJoinMatchmakingSession_Count);
-		}
+	Retry.TimeUntilRetry -= DeltaTime;
+	if (Retry.TimeUntilRetry > 0.0f)
+	{
+		return;
 	}
 
-	RetryJoinLobbySession_TimeSinceLastRetry += DeltaTime;
+	Retry.Count -= 1;
+	Retry.TimeUntilRetry = Retry.Delay * FMath::FRandRange(1.0f - JoinRetryJitter, 1.0f + JoinRetryJitter);
+	Retry.Delay = FMath::Min(Retry.Delay * 2.0f, JoinRetryMaxDelay);
 
-	if (RetryJoinLobbySession_Count > 0)
-	{
-		if (RetryJoinLobbySession_TimeSinceLastRetry > RetryJoinLobbySession_RetryTime)
-		{
-			RetryJoinLobbySession_TimeSinceLastRetry = 0.0f;
-			RetryJoinLobbySession_Count -= 1;
+	OnOperationComplete_TryJoinNetwork(bJoinLobbyOperation, Retry.Count);
+}
 
-			OnOperationComplete_TryJoinNetwork(true, RetryJoinLobbySession_Count);
-		}
-	}
+void FOnlineSessionPlayFab::Tick(float DeltaTime)
+{
+	TickJoinNetworkRetry(RetryJoinMatchmakingSession, false, DeltaTime);
+	TickJoinNetworkRetry(RetryJoinLobbySession, true, DeltaTime);
 
-	OSSPlayFab->GetPlayFabLobbyInterface()->DoWork();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_LobbyDoWork);
+		FPlayFabScopedTickSample TickSample(OSSPlayFab->GetTickProfiler(), EPlayFabTickPhase::LobbyDoWork, OSSPlayFab->Endpoints.Num());
+		OSSPlayFab->GetPlayFabLobbyInterface()->DoWork();
+	}
 
-	OSSPlayFab->GetMatchmakingInterface()->DoWork();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_MatchmakingDoWork);
+		FPlayFabScopedTickSample TickSample(OSSPlayFab->GetTickProfiler(), EPlayFabTickPhase::MatchmakingDoWork, OSSPlayFab->Endpoints.Num());
+		OSSPlayFab->GetMatchmakingInterface()->DoWork();
+	}
 
 	if (bUsesNativeSession)
 	{
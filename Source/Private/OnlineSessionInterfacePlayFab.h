@@ -160,16 +160,27 @@ protected:
 	FDelegateHandle OnUpdateSession_MatchmakingDelegateHandle, OnUpdateLobbyCompleteDelegate;
 	void OnUpdateSession_Matchmaking(FName SessionName, bool bWasSuccessful);
 	void OnUpdateLobbyCompleted(FName SessionName, bool bWasSuccessful);
-
-	float RetryJoinMatchmakingSession_RetryTime = 2.0f;
-	float RetryJoinMatchmakingSession_TimeSinceLastRetry = 0.0f;
-	int32 RetryJoinMatchmakingSession_Count = 0;
-	int32 RetryJoinMatchmakingSession_MaxCount = 15;
-
-	float RetryJoinLobbySession_RetryTime = 2.0f;
-	float RetryJoinLobbySession_TimeSinceLastRetry = 0.0f;
-	int32 RetryJoinLobbySession_Count = 0;
-	int32 RetryJoinLobbySession_MaxCount = 15;
+	// UpdateSession calls waiting on the lobby, which may merge several of them into one update
+	int32 PendingUpdateSessionCount = 0;
+
+	// Waits for the network id and descriptor to reach the session settings before connecting to the network.
+	// The first attempt is immediate, later ones back off exponentially with jitter, and a lobby update for the session retries at once.
+	struct FJoinNetworkRetry
+	{
+		int32 Count = 0;
+		float Delay = 0.0f;
+		float TimeUntilRetry = 0.0f;
+	};
+	FJoinNetworkRetry RetryJoinMatchmakingSession;
+	FJoinNetworkRetry RetryJoinLobbySession;
+
+	float JoinRetryInitialDelay = 0.1f;
+	float JoinRetryMaxDelay = 2.0f;
+	float JoinRetryJitter = 0.25f;
+	int32 JoinRetryMaxCount = 20;
+
+	void ArmJoinNetworkRetry(FJoinNetworkRetry& Retry);
+	void TickJoinNetworkRetry(FJoinNetworkRetry& Retry, bool bJoinLobbyOperation, float DeltaTime);
 
 	FName NativeSessionName = NAME_GameSession;
 #if defined(OSS_PLAYFAB_PLAYSTATION)
@@ -9,6 +9,11 @@
 #include "SocketSubsystem.h"
 #include "IpConnection.h"
 #include "PlayFabNetDriver.h"
+#include "PlayFabBenchmark.h"
+#include "PlayFabStats.h"
+#include "PlayFabStateChangeTrace.h"
+#include "PlayFabJoinTimeline.h"
+#include "PlayFabRegionLatencyCache.h"
 #include "OnlineExternalUIInterfacePlayFab.h"
 
 #include "EngineLogs.h"
@@ -18,6 +23,13 @@
 #include "MatchmakingInterfacePlayFab.h"
 #include "Engine/Engine.h"
 
+DEFINE_STAT(STAT_PlayFab_PartyDoWork);
+DEFINE_STAT(STAT_PlayFab_SocketTick);
+DEFINE_STAT(STAT_PlayFab_VoiceTick);
+DEFINE_STAT(STAT_PlayFab_SessionTick);
+DEFINE_STAT(STAT_PlayFab_LobbyDoWork);
+DEFINE_STAT(STAT_PlayFab_MatchmakingDoWork);
+
 OSS_PLAYFAB_PASSTHROUGH_FUNCTION_DEFINITION(IOnlineFriendsPtr, GetFriendsInterface);
 OSS_PLAYFAB_PASSTHROUGH_FUNCTION_DEFINITION(IOnlinePartyPtr, GetPartyInterface);
 OSS_PLAYFAB_PASSTHROUGH_FUNCTION_DEFINITION(IOnlineGroupsPtr, GetGroupsInterface);
@@ -94,6 +106,14 @@ bool FOnlineSubsystemPlayFab::Init()
 	FCoreDelegates::ApplicationWillEnterBackgroundDelegate.AddRaw(this, &FOnlineSubsystemPlayFab::OnAppSuspend);
 	FCoreDelegates::ApplicationHasEnteredForegroundDelegate.AddRaw(this, &FOnlineSubsystemPlayFab::OnAppResume);
 	
+	bool bEnableRegionLatencyCache = false;
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableRegionLatencyCache"), bEnableRegionLatencyCache, GEngineIni);
+	if (bEnableRegionLatencyCache)
+	{
+		RegionLatencyCache = MakeShared<FPlayFabRegionLatencyCache>();
+		RegionLatencyCache->Load();
+	}
+
 	RegisterNetworkInitCallbacks();
 
 	// Try to initialize PlayFab Party if the platform is ready
@@ -105,6 +125,11 @@ bool FOnlineSubsystemPlayFab::Init()
 	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("MaxUserCount"), MaxUserCount, GEngineIni);
 	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("MaxUsersPerDeviceCount"), MaxUsersPerDeviceCount, GEngineIni);
 	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bForceAutoLogin"), bForceAutoLogin, GEngineIni);
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnablePartyNetworkPrewarm"), bEnablePartyNetworkPrewarm, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("PartyNetworkPrewarmMaxAge"), PartyNetworkPrewarmMaxAge, GEngineIni);
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableHostNetworkWarmPool"), bEnableHostNetworkWarmPool, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("HostNetworkWarmPoolRetryInterval"), HostNetworkWarmPoolRetryInterval, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("HostNetworkWarmPoolMaxRefillsPerHour"), HostNetworkWarmPoolMaxRefillsPerHour, GEngineIni);
 
 	ParseDirectPeerConnectivityOptions();
 
@@ -118,8 +143,29 @@ bool FOnlineSubsystemPlayFab::Init()
 	if (FPlayFabSocketSubsystem* SocketSubsystem = static_cast<FPlayFabSocketSubsystem*>(ISocketSubsystem::Get(PLAYFAB_SOCKET_SUBSYSTEM)))
 	{
 		SocketSubsystem->RegisterDelegates(this);
+
+		bool bEnablePacketCapture = false;
+		GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnablePacketCapture"), bEnablePacketCapture, GEngineIni);
+		if (bEnablePacketCapture)
+		{
+			FString PacketCaptureFilename;
+			GConfig->GetString(TEXT("OnlineSubsystemPlayFab"), TEXT("PacketCaptureFilename"), PacketCaptureFilename, GEngineIni);
+			SocketSubsystem->StartPacketCapture(PacketCaptureFilename);
+		}
 	}
 
+	bool bEnableStateChangeTrace = false;
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableStateChangeTrace"), bEnableStateChangeTrace, GEngineIni);
+	if (bEnableStateChangeTrace)
+	{
+		FString StateChangeTraceFilename;
+		GConfig->GetString(TEXT("OnlineSubsystemPlayFab"), TEXT("StateChangeTraceFilename"), StateChangeTraceFilename, GEngineIni);
+		StateChangeTrace = MakeShared<FPlayFabStateChangeTrace>();
+		StateChangeTrace->Start(StateChangeTraceFilename);
+	}
+
+	JoinTimeline = MakeShared<FPlayFabJoinTimeline>();
+
 	// Initialize Multiplayer
 	InitializeMultiplayer();
 
@@ -151,6 +197,20 @@ void FOnlineSubsystemPlayFab::InitializePlayFabParty()
 		FString TitleID;
 		GConfig->GetString(TEXT("OnlineSubsystemPlayFab"), TEXT("PlayFabTitleID"), TitleID, GEngineIni);
 
+		// With fresh cached latencies there is no need to probe regions on startup, networks are created with the cached list instead.
+		// Party still refreshes once the cache would have expired, zero would stop it from ever measuring again.
+		if (RegionLatencyCache.IsValid() && RegionLatencyCache->IsFresh())
+		{
+			PartyRegionUpdateConfiguration RegionUpdateConfig = {};
+			RegionUpdateConfig.mode = PartyRegionUpdateMode::Deferred;
+			RegionUpdateConfig.refreshIntervalInSeconds = static_cast<uint32_t>(FMath::Max(RegionLatencyCache->GetMaxAgeSeconds(), 30.0f));
+			PartyError OptionErr = PartyManager::SetOption(nullptr, PartyOption::RegionUpdateConfiguration, &RegionUpdateConfig);
+			if (PARTY_FAILED(OptionErr))
+			{
+				UE_LOG_ONLINE(Warning, TEXT("FOnlineSubsystemPlayFab::InitializePlayFabParty: Deferring region updates failed: %s"), *GetPartyErrorMessage(OptionErr));
+			}
+		}
+
 		// Initialize PlayFab Party
 		PartyError Err = Manager.Initialize(TCHAR_TO_UTF8(*TitleID));
 		if (PARTY_FAILED(Err))
@@ -283,6 +343,16 @@ bool FOnlineSubsystemPlayFab::Shutdown()
 
 	FOnlineSubsystemImpl::Shutdown();
 
+	DiscardPrewarmedPlayFabPartyNetwork(TEXT("shutdown"));
+	if (bEnablePartyNetworkPrewarm)
+	{
+		UE_LOG_ONLINE(Log, TEXT("OnlineSubsystemPlayFab::Shutdown: Party network prewarm used %u, wasted %u, saved %.3fs"), PrewarmedNetworksUsed, PrewarmedNetworksWasted, PrewarmSecondsSaved);
+	}
+	if (bEnableHostNetworkWarmPool)
+	{
+		UE_LOG_ONLINE(Log, TEXT("OnlineSubsystemPlayFab::Shutdown: Host network warm pool hits %u, misses %u, wasted %u, refills skipped by the hourly cap %u"), HostNetworkWarmPoolHits, HostNetworkWarmPoolMisses, HostNetworkWarmPoolWasted, HostNetworkWarmPoolRefillsSkipped);
+	}
+
 	NetworkState = EPlayFabPartyNetworkState::NoNetwork;
 
 #ifdef OSS_PLAYFAB_PLAYSTATION
@@ -346,6 +416,147 @@ bool FOnlineSubsystemPlayFab::Exec(class UWorld* InWorld, const TCHAR* Cmd, FOut
 
 	bool bWasHandled = false;
 
+	if (FParse::Command(&Cmd, TEXT("PLAYFAB")))
+	{
+		FPlayFabSocketSubsystem* SocketSubsystem = static_cast<FPlayFabSocketSubsystem*>(ISocketSubsystem::Get(PLAYFAB_SOCKET_SUBSYSTEM));
+		if (SocketSubsystem == nullptr)
+		{
+			Ar.Logf(TEXT("PlayFab socket subsystem is not available"));
+			return true;
+		}
+
+		if (FParse::Command(&Cmd, TEXT("CAPTURE")))
+		{
+			// PLAYFAB CAPTURE START [Filename] | PLAYFAB CAPTURE STOP
+			if (FParse::Command(&Cmd, TEXT("START")))
+			{
+				const FString Filename = FParse::Token(Cmd, false);
+				Ar.Logf(TEXT("Packet capture %s"), SocketSubsystem->StartPacketCapture(Filename) ? TEXT("started") : TEXT("failed to start"));
+				bWasHandled = true;
+			}
+			else if (FParse::Command(&Cmd, TEXT("STOP")))
+			{
+				SocketSubsystem->StopPacketCapture();
+				Ar.Logf(TEXT("Packet capture stopped"));
+				bWasHandled = true;
+			}
+		}
+		else if (FParse::Command(&Cmd, TEXT("REPLAY")))
+		{
+			// PLAYFAB REPLAY <Filename>
+			const FString Filename = FParse::Token(Cmd, false);
+			Ar.Logf(TEXT("Packet replay %s"), SocketSubsystem->StartPacketReplay(Filename) ? TEXT("started") : TEXT("failed to start"));
+			bWasHandled = true;
+		}
+		else if (FParse::Command(&Cmd, TEXT("LOOPBACKCHECK")))
+		{
+			// PLAYFAB LOOPBACKCHECK
+			SocketSubsystem->RunLoopbackCheck(Ar);
+			bWasHandled = true;
+		}
+		else if (FParse::Command(&Cmd, TEXT("STATETRACE")))
+		{
+			// PLAYFAB STATETRACE START [Filename] | PLAYFAB STATETRACE STOP | PLAYFAB STATETRACE REPORT <Filename>
+			if (FParse::Command(&Cmd, TEXT("START")))
+			{
+				if (!StateChangeTrace.IsValid())
+				{
+					StateChangeTrace = MakeShared<FPlayFabStateChangeTrace>();
+				}
+				const FString Filename = FParse::Token(Cmd, false);
+				Ar.Logf(TEXT("State change trace %s"), StateChangeTrace->Start(Filename) ? TEXT("started") : TEXT("failed to start"));
+				bWasHandled = true;
+			}
+			else if (FParse::Command(&Cmd, TEXT("STOP")))
+			{
+				if (StateChangeTrace.IsValid())
+				{
+					StateChangeTrace->Stop();
+				}
+				Ar.Logf(TEXT("State change trace stopped"));
+				bWasHandled = true;
+			}
+			else if (FParse::Command(&Cmd, TEXT("REPORT")))
+			{
+				const FString Filename = FParse::Token(Cmd, false);
+				TSharedPtr<FJsonObject> Report = FPlayFabStateChangeTrace::BuildReport(Filename);
+				if (Report.IsValid())
+				{
+					FPlayFabBenchmark::WriteResults(TEXT("StateChangeTrace"), Report.ToSharedRef(), Ar);
+				}
+				else
+				{
+					Ar.Logf(TEXT("Failed to read state change trace %s"), *Filename);
+				}
+				bWasHandled = true;
+			}
+		}
+		else if (FParse::Command(&Cmd, TEXT("JOINSTATS")))
+		{
+			// PLAYFAB JOINSTATS
+			FPlayFabBenchmark::WriteResults(TEXT("JoinTimeline"), JoinTimeline->BuildReport(), Ar);
+			bWasHandled = true;
+		}
+		else if (FParse::Command(&Cmd, TEXT("BENCHMARK")))
+		{
+			// PLAYFAB BENCHMARK SOCKET [Iterations=N]
+			if (FParse::Command(&Cmd, TEXT("SOCKET")))
+			{
+				int32 Iterations = 100000;
+				FParse::Value(Cmd, TEXT("Iterations="), Iterations);
+				FPlayFabBenchmark::RunSocketBenchmark(this, Iterations, Ar);
+				bWasHandled = true;
+			}
+			// PLAYFAB BENCHMARK LOBBYRESULTS [Iterations=N] [Lobbies=N]
+			else if (FParse::Command(&Cmd, TEXT("LOBBYRESULTS")))
+			{
+				int32 Iterations = 1000;
+				int32 LobbyCount = 50;
+				FParse::Value(Cmd, TEXT("Iterations="), Iterations);
+				FParse::Value(Cmd, TEXT("Lobbies="), LobbyCount);
+				FPlayFabBenchmark::RunLobbyResultBenchmark(this, Iterations, LobbyCount, Ar);
+				bWasHandled = true;
+			}
+			// PLAYFAB BENCHMARK SEARCHKEYS [Iterations=N] [Lobbies=N]
+			else if (FParse::Command(&Cmd, TEXT("SEARCHKEYS")))
+			{
+				int32 Iterations = 1000;
+				int32 LobbyCount = 200;
+				FParse::Value(Cmd, TEXT("Iterations="), Iterations);
+				FParse::Value(Cmd, TEXT("Lobbies="), LobbyCount);
+				FPlayFabBenchmark::RunSearchKeyBenchmark(this, Iterations, LobbyCount, Ar);
+				bWasHandled = true;
+			}
+			// PLAYFAB BENCHMARK TICKS START | PLAYFAB BENCHMARK TICKS STOP
+			else if (FParse::Command(&Cmd, TEXT("TICKS")))
+			{
+				if (FParse::Command(&Cmd, TEXT("START")))
+				{
+					if (!TickProfiler.IsValid())
+					{
+						TickProfiler = MakeShared<FPlayFabTickProfiler>();
+					}
+					TickProfiler->Start();
+					Ar.Logf(TEXT("Tick profiling started"));
+					bWasHandled = true;
+				}
+				else if (FParse::Command(&Cmd, TEXT("STOP")))
+				{
+					if (TickProfiler.IsValid() && TickProfiler->IsRunning())
+					{
+						TickProfiler->Stop();
+						FPlayFabBenchmark::WriteTickProfile(*TickProfiler, Ar);
+					}
+					else
+					{
+						Ar.Logf(TEXT("Tick profiling is not running"));
+					}
+					bWasHandled = true;
+				}
+			}
+		}
+	}
+
 	return bWasHandled;
 }
 
@@ -508,15 +719,32 @@ bool FOnlineSubsystemPlayFab::Tick(float DeltaTime)
 		EventTracer->DoWork();
 	}
 
-	DoWork();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_PartyDoWork);
+		FPlayFabScopedTickSample TickSample(TickProfiler.Get(), EPlayFabTickPhase::PartyDoWork, Endpoints.Num());
+		DoWork();
+	}
+
+	MaintainHostNetworkWarmPool();
+
+	if (FPlayFabSocketSubsystem* SocketSubsystem = static_cast<FPlayFabSocketSubsystem*>(ISocketSubsystem::Get(PLAYFAB_SOCKET_SUBSYSTEM)))
+	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_SocketTick);
+		FPlayFabScopedTickSample TickSample(TickProfiler.Get(), EPlayFabTickPhase::SocketTick, Endpoints.Num());
+		SocketSubsystem->Tick(DeltaTime);
+	}
 
 	if (VoiceInterface.IsValid())
 	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_VoiceTick);
+		FPlayFabScopedTickSample TickSample(TickProfiler.Get(), EPlayFabTickPhase::VoiceTick, Endpoints.Num());
 		VoiceInterface->Tick(DeltaTime);
 	}
 
 	if (SessionInterface.IsValid())
 	{
+		SCOPE_CYCLE_COUNTER(STAT_PlayFab_SessionTick);
+		FPlayFabScopedTickSample TickSample(TickProfiler.Get(), EPlayFabTickPhase::SessionTick, Endpoints.Num());
 		SessionInterface->Tick(DeltaTime);
 	}
 
@@ -590,6 +818,9 @@ void FOnlineSubsystemPlayFab::DoWork()
 	PartyStateChangeArray Changes;
 	PartyManager& Manager = PartyManager::GetSingleton();
 
+	FPlayFabStateChangeTrace* Trace = StateChangeTrace.IsValid() && StateChangeTrace->IsRecording() ? StateChangeTrace.Get() : nullptr;
+	const uint64 BatchStartCycles = Trace ? FPlatformTime::Cycles64() : 0;
+
 	// Start processing messages from PlayFab Party
 	PartyError Err = Manager.StartProcessingStateChanges(&Count, &Changes);
 	if (PARTY_FAILED(Err))
@@ -604,6 +835,8 @@ void FOnlineSubsystemPlayFab::DoWork()
 
 		if (Change)
 		{
+			const uint64 HandlerStartCycles = Trace ? FPlatformTime::Cycles64() : 0;
+
 			switch (Change->stateChangeType)
 			{
 			case PartyStateChangeType::RegionsChanged:									 OnRegionsChanged(Change); break;
@@ -664,6 +897,11 @@ void FOnlineSubsystemPlayFab::DoWork()
 			case PartyStateChangeType::SetTextChatOptionsCompleted:						 CognitiveServicesInterface->OnSetTextChatOptionsCompleted(Change); break;
 			case PartyStateChangeType::PopulateAvailableTextToSpeechProfilesCompleted:	 CognitiveServicesInterface->OnPopulateAvailableTextToSpeechProfilesCompleted(Change); break;
 			}
+
+			if (Trace)
+			{
+				Trace->RecordStateChange(EPlayFabStateChangeSource::Party, static_cast<uint32>(Change->stateChangeType), FPlatformTime::Cycles64() - HandlerStartCycles);
+			}
 		}
 	}
 	
@@ -673,6 +911,11 @@ void FOnlineSubsystemPlayFab::DoWork()
 	{
 		UE_LOG_ONLINE(Warning, TEXT("FOnlineSubsystemPlayFab::DoWork: FinishProcessingStateChanges failed: %s"), *GetPartyErrorMessage(Err));
 	}
+
+	if (Trace)
+	{
+		Trace->RecordBatch(EPlayFabStateChangeSource::Party, Count, FPlatformTime::Cycles64() - BatchStartCycles);
+	}
 }
 
 bool FOnlineSubsystemPlayFab::CreateAndConnectToPlayFabPartyNetwork()
@@ -698,8 +941,172 @@ bool FOnlineSubsystemPlayFab::CreateAndConnectToPlayFabPartyNetwork()
 		return false;
 	}
 
-	const FString NewNetworkId = FGuid::NewGuid().ToString();
-	const std::string NetworkIdStr = TCHAR_TO_UTF8(*NewNetworkId);
+	FString NewNetworkId;
+	PartyNetworkDescriptor NewNetworkDescriptor = {};
+
+	if (PrewarmedNetwork.bValid && FPlatformTime::Seconds() - PrewarmedNetwork.StartTime <= PartyNetworkPrewarmMaxAge)
+	{
+		// The creation round trip already happened (or is under way) while the ticket was queued
+		const double Now = FPlatformTime::Seconds();
+		const double SecondsSaved = (PrewarmedNetwork.ReadyTime > 0.0 ? PrewarmedNetwork.ReadyTime : Now) - PrewarmedNetwork.StartTime;
+		if (PrewarmedNetwork.bFromWarmPool)
+		{
+			HostNetworkWarmPoolHits++;
+		}
+		else
+		{
+			PrewarmSecondsSaved += SecondsSaved;
+			PrewarmedNetworksUsed++;
+		}
+
+		UE_LOG_ONLINE(Log, TEXT("FOnlineSubsystemPlayFab::CreateAndConnectToPlayFabPartyNetwork: Using prewarmed network %s, saved %.3fs"), *PrewarmedNetwork.NetworkId, SecondsSaved);
+
+		NewNetworkId = PrewarmedNetwork.NetworkId;
+		NewNetworkDescriptor = PrewarmedNetwork.NetworkDescriptor;
+		PrewarmedNetwork = FPrewarmedPartyNetwork();
+	}
+	else
+	{
+		DiscardPrewarmedPlayFabPartyNetwork(TEXT("expired"));
+		HostNetworkWarmPoolMisses += bEnableHostNetworkWarmPool ? 1 : 0;
+
+		NewNetworkId = FGuid::NewGuid().ToString();
+		if (!InternalCreateNetwork(FirstPartyLocalUser, NewNetworkId, NewNetworkDescriptor, nullptr))
+		{
+			return false;
+		}
+	}
+
+	// Connect to the new network
+	if (InternalConnectToNetwork(FirstPartyLocalUser, NewNetworkId, NewNetworkDescriptor))
+	{
+		NetworkState = EPlayFabPartyNetworkState::JoiningNetwork_Host;
+		NetworkId = NewNetworkId;
+		JoinTimeline->MarkPhase(EPlayFabJoinPhase::NetworkConnectRequested);
+
+		return true;
+	}
+
+	return false;
+}
+
+static void* GetPrewarmAsyncIdentifier(uint64 Generation)
+{
+	return reinterpret_cast<void*>(static_cast<UPTRINT>(Generation));
+}
+
+void FOnlineSubsystemPlayFab::PrewarmPlayFabPartyNetwork()
+{
+	if (bEnablePartyNetworkPrewarm)
+	{
+		InternalPrewarmNetwork(false);
+	}
+}
+
+void FOnlineSubsystemPlayFab::MaintainHostNetworkWarmPool()
+{
+	if (!bEnableHostNetworkWarmPool || !bPartyInitialized)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (PrewarmedNetwork.bValid)
+	{
+		if (Now - PrewarmedNetwork.StartTime > PartyNetworkPrewarmMaxAge)
+		{
+			DiscardPrewarmedPlayFabPartyNetwork(TEXT("expired"));
+		}
+		return;
+	}
+
+	// Refill once the previous network is gone, throttled so a failing creation is not retried every frame
+	if (Now - LastHostNetworkWarmPoolAttemptTime < HostNetworkWarmPoolRetryInterval)
+	{
+		return;
+	}
+	LastHostNetworkWarmPoolAttemptTime = Now;
+
+	if (HostNetworkWarmPoolMaxRefillsPerHour > 0)
+	{
+		HostNetworkWarmPoolRefillTimes.RemoveAll([Now](double RefillTime) { return Now - RefillTime > 3600.0; });
+		if (HostNetworkWarmPoolRefillTimes.Num() >= HostNetworkWarmPoolMaxRefillsPerHour)
+		{
+			HostNetworkWarmPoolRefillsSkipped++;
+			UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::MaintainHostNetworkWarmPool: %d refills in the last hour, waiting before creating another network"), HostNetworkWarmPoolRefillTimes.Num());
+			return;
+		}
+	}
+
+	if (InternalPrewarmNetwork(true))
+	{
+		HostNetworkWarmPoolRefillTimes.Add(Now);
+	}
+}
+
+bool FOnlineSubsystemPlayFab::InternalPrewarmNetwork(bool bFromWarmPool)
+{
+	if (!bPartyInitialized || PrewarmedNetwork.bValid)
+	{
+		return false;
+	}
+
+	if (NetworkState != EPlayFabPartyNetworkState::NoNetwork || Network != nullptr)
+	{
+		return false;
+	}
+
+	PartyLocalUser* FirstPartyLocalUser = IdentityInterface ? IdentityInterface->GetFirstPartyLocalUser() : nullptr;
+	if (FirstPartyLocalUser == nullptr)
+	{
+		return false;
+	}
+
+	FPrewarmedPartyNetwork NewPrewarmedNetwork;
+	NewPrewarmedNetwork.NetworkId = FGuid::NewGuid().ToString();
+	NewPrewarmedNetwork.StartTime = FPlatformTime::Seconds();
+	NewPrewarmedNetwork.Generation = NextPrewarmGeneration++;
+	NewPrewarmedNetwork.bFromWarmPool = bFromWarmPool;
+	if (InternalCreateNetwork(FirstPartyLocalUser, NewPrewarmedNetwork.NetworkId, NewPrewarmedNetwork.NetworkDescriptor, GetPrewarmAsyncIdentifier(NewPrewarmedNetwork.Generation)))
+	{
+		NewPrewarmedNetwork.bValid = true;
+		PrewarmedNetwork = NewPrewarmedNetwork;
+		UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::InternalPrewarmNetwork: Prewarming network %s"), *PrewarmedNetwork.NetworkId);
+		return true;
+	}
+
+	return false;
+}
+
+void FOnlineSubsystemPlayFab::DiscardPrewarmedPlayFabPartyNetwork(const TCHAR* Reason)
+{
+	if (PrewarmedNetwork.bValid)
+	{
+		// Nobody connects to it, so Party tears the network down on its own
+		UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::DiscardPrewarmedPlayFabPartyNetwork: Discarding prewarmed network %s (%s)"), *PrewarmedNetwork.NetworkId, Reason);
+		if (PrewarmedNetwork.bFromWarmPool)
+		{
+			HostNetworkWarmPoolWasted++;
+		}
+		else
+		{
+			PrewarmedNetworksWasted++;
+		}
+		PrewarmedNetwork = FPrewarmedPartyNetwork();
+	}
+}
+
+void FOnlineSubsystemPlayFab::DiscardMatchmakingPrewarmedPlayFabPartyNetwork(const TCHAR* Reason)
+{
+	if (PrewarmedNetwork.bValid && !PrewarmedNetwork.bFromWarmPool)
+	{
+		DiscardPrewarmedPlayFabPartyNetwork(Reason);
+	}
+}
+
+bool FOnlineSubsystemPlayFab::InternalCreateNetwork(PartyLocalUser* PlayFabPartyLocalUser, const FString& InNetworkId, Party::PartyNetworkDescriptor& OutNetworkDescriptor, void* AsyncIdentifier)
+{
+	const std::string NetworkIdStr = TCHAR_TO_UTF8(*InNetworkId);
 
 	PartyNetworkConfiguration PlayFabPartyNetworkConfig = {};
 
@@ -719,36 +1126,29 @@ bool FOnlineSubsystemPlayFab::CreateAndConnectToPlayFabPartyNetwork()
 		nullptr									// Authorized user list
 	};
 
-	PartyNetworkDescriptor NewNetworkDescriptor = {};
+	TArray<PartyRegion> PreferredRegions;
+	bNetworkCreateUsedCachedRegions = RegionLatencyCache.IsValid() && RegionLatencyCache->GetPreferredRegions(PreferredRegions);
+	NetworkCreateStartTime = FPlatformTime::Seconds();
 
 	// Create a new network descriptor
 	PartyError Err = PartyManager::GetSingleton().CreateNewNetwork(
-		FirstPartyLocalUser,		// Local User
+		PlayFabPartyLocalUser,		// Local User
 		&PlayFabPartyNetworkConfig,	// Network Config
-		0,							// Region List Count
-		nullptr,					// Region List
+		PreferredRegions.Num(),		// Region List Count
+		PreferredRegions.GetData(),	// Region List
 		&PartyInviteConfig,			// Invitation configuration
-		nullptr,					// Async Identifier
-		&NewNetworkDescriptor,		// OUT network descriptor
+		AsyncIdentifier,			// Async Identifier
+		&OutNetworkDescriptor,		// OUT network descriptor
 		nullptr						// Applied initial invitation identifier
 	);
 
 	if (PARTY_FAILED(Err))
 	{
-		UE_LOG_ONLINE(Warning, TEXT("FOnlineSubsystemPlayFab::CreateAndConnectToPlayFabPartyNetwork: CreateNewNetwork failed: %s"), *GetPartyErrorMessage(Err));
+		UE_LOG_ONLINE(Warning, TEXT("FOnlineSubsystemPlayFab::InternalCreateNetwork: CreateNewNetwork failed: %s"), *GetPartyErrorMessage(Err));
 		return false;
 	}
 
-	// Connect to the new network
-	if (InternalConnectToNetwork(FirstPartyLocalUser, NewNetworkId, NewNetworkDescriptor))
-	{
-		NetworkState = EPlayFabPartyNetworkState::JoiningNetwork_Host;
-		NetworkId = NewNetworkId;
-
-		return true;
-	}
-
-	return false;
+	return true;
 }
 
 bool FOnlineSubsystemPlayFab::ConnectToPlayFabPartyNetwork(const FString& NewNetworkId, const FString& NewNetworkDescriptorStr)
@@ -785,11 +1185,18 @@ bool FOnlineSubsystemPlayFab::ConnectToPlayFabPartyNetwork(const FString& NewNet
 		return false;
 	}
 
+	// Another member hosts the match, so a prewarmed network of our own will not be needed unless the warm pool keeps it for later hosting
+	if (!bEnableHostNetworkWarmPool)
+	{
+		DiscardPrewarmedPlayFabPartyNetwork(TEXT("joining remote network"));
+	}
+
 	// Connect to the remote network
 	if (InternalConnectToNetwork(FirstPartyLocalUser, NewNetworkId, NewNetworkDescriptor))
 	{
 		NetworkState = EPlayFabPartyNetworkState::JoiningNetwork_Client;
 		NetworkId = NewNetworkId;
+		JoinTimeline->MarkPhase(EPlayFabJoinPhase::NetworkConnectRequested);
 
 		return true;
 	}
@@ -1039,9 +1446,20 @@ void FOnlineSubsystemPlayFab::OnCreateNewNetworkCompleted(const PartyStateChange
 	const PartyCreateNewNetworkCompletedStateChange* Result = static_cast<const PartyCreateNewNetworkCompletedStateChange*>(Change);
 	if (Result)
 	{
+		if (NetworkCreateStartTime > 0.0)
+		{
+			UE_LOG_ONLINE(Log, TEXT("FOnlineSubsystemPlayFab::OnCreateNewNetworkCompleted: Network ready in %.3fs using %s regions"),
+				FPlatformTime::Seconds() - NetworkCreateStartTime, bNetworkCreateUsedCachedRegions ? TEXT("cached") : TEXT("probed"));
+			NetworkCreateStartTime = 0.0;
+		}
+
 		if (Result->result == PartyStateChangeResult::Succeeded)
 		{
 			UE_LOG_ONLINE(Verbose, TEXT("CreateNewNetworkCompleted: SUCCESS"));
+			if (PrewarmedNetwork.bValid && Result->asyncIdentifier == GetPrewarmAsyncIdentifier(PrewarmedNetwork.Generation))
+			{
+				PrewarmedNetwork.ReadyTime = FPlatformTime::Seconds();
+			}
 			if (Result->localUser)
 			{
 				PartyString EntityId;
@@ -1054,6 +1472,10 @@ void FOnlineSubsystemPlayFab::OnCreateNewNetworkCompleted(const PartyStateChange
 		{
 			UE_LOG_ONLINE(Warning, TEXT("CreateNewNetworkCompleted: FAIL: %s"), *PartyStateChangeResultToReasonString(Result->result));
 			UE_LOG_ONLINE(Warning, TEXT("ErrorDetail: %s"), *GetPartyErrorMessage(Result->errorDetail));
+			if (PrewarmedNetwork.bValid && Result->asyncIdentifier == GetPrewarmAsyncIdentifier(PrewarmedNetwork.Generation))
+			{
+				DiscardPrewarmedPlayFabPartyNetwork(TEXT("creation failed"));
+			}
 		}
 	}
 }
@@ -1068,6 +1490,7 @@ void FOnlineSubsystemPlayFab::OnConnectToNetworkCompleted(const PartyStateChange
 		if (Result->result == PartyStateChangeResult::Succeeded)
 		{
 			UE_LOG_ONLINE(Verbose, TEXT("ConnectToNetworkCompleted: SUCCESS"));
+			JoinTimeline->MarkPhase(EPlayFabJoinPhase::NetworkConnected);
 
 			// We branch here if we are the host, since we need to wait for the local endpoint to be created to store the info in the session / have a valid 'PlayFab IP addr' class instance
 			if (NetworkState == EPlayFabPartyNetworkState::JoiningNetwork_Host)
@@ -1087,6 +1510,7 @@ void FOnlineSubsystemPlayFab::OnConnectToNetworkCompleted(const PartyStateChange
 			UE_LOG_ONLINE(Warning, TEXT("ConnectToNetworkCompleted: FAIL:  %s"), *PartyStateChangeResultToReasonString(Result->result));
 			UE_LOG_ONLINE(Warning, TEXT("ErrorDetail: %s"), *GetPartyErrorMessage(Result->errorDetail));
 
+			JoinTimeline->Finish(false);
 			TriggerOnConnectToPlayFabPartyNetworkCompletedDelegates(false);
 		}
 	}
@@ -1274,12 +1698,15 @@ void FOnlineSubsystemPlayFab::OnEndpointCreated(const PartyStateChange* Change)
 
 				
 
+				JoinTimeline->Finish(false);
 				TriggerOnPartyEndpointCreatedDelegates(false, 0, bIsHosting);
 			}
 			else
 			{
 				Endpoints.Add(EndpointId, NewEndpoint);
 				NetworkState = EPlayFabPartyNetworkState::NetworkReady;
+				JoinTimeline->MarkPhase(EPlayFabJoinPhase::EndpointCreated);
+				JoinTimeline->Finish(true);
 				TriggerOnPartyEndpointCreatedDelegates(true, EndpointId, bIsHosting);
 
 				UE_LOG(LogNet, Warning, TEXT("FOnlineSubsystemPlayFab::OnEndpointCreate: Created Party Endpoint: %d"), EndpointId);
@@ -1288,6 +1715,7 @@ void FOnlineSubsystemPlayFab::OnEndpointCreated(const PartyStateChange* Change)
 		else
 		{
 			UE_LOG_ONLINE(Warning, TEXT("FOnlineSubsystemPlayFab::OnEndpointCreated: returned enpoint was invalid"));
+			JoinTimeline->Finish(false);
 			TriggerOnPartyEndpointCreatedDelegates(false, 0, bIsHosting);
 		}
 	}
@@ -1365,9 +1793,44 @@ void FOnlineSubsystemPlayFab::OnEndpointPropertiesChanged(const PartyStateChange
 	UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::OnEndpointPropertiesChanged"));
 }
 
+bool FOnlineSubsystemPlayFab::GetRegionRoundTripTimes(TMap<FString, uint32>& OutRoundTripMs) const
+{
+	if (RegionLatencyCache.IsValid() && RegionLatencyCache->GetRoundTripTimes(OutRoundTripMs))
+	{
+		return true;
+	}
+
+	OutRoundTripMs.Reset();
+	if (!bPartyInitialized)
+	{
+		return false;
+	}
+
+	uint32_t RegionCount = 0;
+	const PartyRegion* PartyRegions = nullptr;
+	PartyError Err = PartyManager::GetSingleton().GetRegions(&RegionCount, &PartyRegions);
+	if (PARTY_FAILED(Err))
+	{
+		UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::GetRegionRoundTripTimes: GetRegions failed: %s"), *GetPartyErrorMessage(Err));
+		return false;
+	}
+
+	for (uint32_t RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		OutRoundTripMs.Add(UTF8_TO_TCHAR(PartyRegions[RegionIndex].regionName), PartyRegions[RegionIndex].roundTripLatencyInMilliseconds);
+	}
+	return OutRoundTripMs.Num() > 0;
+}
+
 void FOnlineSubsystemPlayFab::OnRegionsChanged(const PartyStateChange* Change)
 {
 	UE_LOG_ONLINE(Verbose, TEXT("FOnlineSubsystemPlayFab::OnRegionsChanged"));
+
+	const PartyRegionsChangedStateChange* Result = static_cast<const PartyRegionsChangedStateChange*>(Change);
+	if (Result && Result->result == PartyStateChangeResult::Succeeded && RegionLatencyCache.IsValid())
+	{
+		RegionLatencyCache->UpdateFromParty();
+	}
 }
 
 void FOnlineSubsystemPlayFab::OnDestroyLocalUserCompleted(const PartyStateChange* Change)
@@ -28,6 +28,7 @@
 #define SETTING_PLATFORM_ID FString(TEXT("PlatformId"))
 #define SETTING_PLATFORM_MODEL FString(TEXT("PlatformModel"))
 #define SETTING_HOST_NICKNAME FName(TEXT("OWNERNICKNAME"))
+#define SETTING_HOST_REGION FName(TEXT("OWNERREGION"))
 
 // Lobby related errors
 #define XBOX_E_LOBBY_NOT_JOINABLE 0x89236227
@@ -63,7 +64,7 @@
 
 // Lobby related search property keys
 // There are already predefined keys defined in PlayFabLobby.cpp from s_SearchKeyMappingTable.
-// FPlayFabLobby::BuildSearchKeyMappingTable() will construct the predefined keys.
+// FPlayFabLobby::BuildSearchKeyMappingTable() will construct the predefined keys, then apply SearchKeyMappings from the engine ini.
 // Please be careful to avoid overlapping existing keys.
 #define SEARCH_KEY_PREFIX_STRING FString(TEXT("string_"))
 #define SEARCH_KEY_PREFIX_NUMBER FString(TEXT("number_"))
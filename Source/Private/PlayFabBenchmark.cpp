@@ -0,0 +1,456 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PlayFabBenchmark.h"
+#include "PlayFabHelpers.h"
+#include "PlayFabSocket.h"
+#include "PlayFabSocketSubsystem.h"
+#include "IPAddressPlayFab.h"
+#include "OnlineSubsystemPlayFab.h"
+#include "PlayFabLobby.h"
+#include "PlayFabUtils.h"
+
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/MiscTrace.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Paths.h"
+#include "Online/OnlineSessionNames.h"
+
+static double CyclesToNanoseconds(uint64 Cycles)
+{
+	return FPlatformTime::ToSeconds64(Cycles) * 1000000000.0;
+}
+
+const TCHAR* LexToString(EPlayFabTickPhase Phase)
+{
+	switch (Phase)
+	{
+	case EPlayFabTickPhase::PartyDoWork:		return TEXT("PartyDoWork");
+	case EPlayFabTickPhase::SocketTick:			return TEXT("SocketTick");
+	case EPlayFabTickPhase::VoiceTick:			return TEXT("VoiceTick");
+	case EPlayFabTickPhase::SessionTick:		return TEXT("SessionTick");
+	case EPlayFabTickPhase::LobbyDoWork:		return TEXT("LobbyDoWork");
+	case EPlayFabTickPhase::MatchmakingDoWork:	return TEXT("MatchmakingDoWork");
+	default:									return TEXT("Unknown");
+	}
+}
+
+void FPlayFabTickProfiler::Start()
+{
+	Buckets.Reset();
+	StartTime = FPlatformTime::Seconds();
+	bRunning = true;
+}
+
+void FPlayFabTickProfiler::AddSample(EPlayFabTickPhase Phase, int32 EndpointCount, uint64 Cycles)
+{
+	FPhaseSamples& Samples = Buckets.FindOrAdd(EndpointCount).Phases[static_cast<uint8>(Phase)];
+	Samples.TotalCycles += Cycles;
+	Samples.MaxCycles = FMath::Max(Samples.MaxCycles, Cycles);
+	Samples.SampleCount++;
+}
+
+TSharedRef<FJsonObject> FPlayFabTickProfiler::BuildResults() const
+{
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("Benchmark"), TEXT("Ticks"));
+	Results->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Results->SetNumberField(TEXT("DurationSeconds"), FPlatformTime::Seconds() - StartTime);
+
+	TArray<int32> EndpointCounts;
+	Buckets.GetKeys(EndpointCounts);
+	EndpointCounts.Sort();
+
+	TArray<TSharedPtr<FJsonValue>> Curve;
+	for (const int32 EndpointCount : EndpointCounts)
+	{
+		const FEndpointCountBucket& Bucket = Buckets.FindChecked(EndpointCount);
+
+		TSharedPtr<FJsonObject> Point = MakeShared<FJsonObject>();
+		Point->SetNumberField(TEXT("Endpoints"), EndpointCount);
+		for (uint8 PhaseIndex = 0; PhaseIndex < static_cast<uint8>(EPlayFabTickPhase::Count); ++PhaseIndex)
+		{
+			const FPhaseSamples& Samples = Bucket.Phases[PhaseIndex];
+			if (Samples.SampleCount == 0)
+			{
+				continue;
+			}
+
+			TSharedPtr<FJsonObject> Phase = MakeShared<FJsonObject>();
+			Phase->SetNumberField(TEXT("Samples"), Samples.SampleCount);
+			Phase->SetNumberField(TEXT("AverageUs"), CyclesToNanoseconds(Samples.TotalCycles) / 1000.0 / Samples.SampleCount);
+			Phase->SetNumberField(TEXT("MaxUs"), CyclesToNanoseconds(Samples.MaxCycles) / 1000.0);
+			Point->SetObjectField(LexToString(static_cast<EPlayFabTickPhase>(PhaseIndex)), Phase);
+		}
+		Curve.Add(MakeShared<FJsonValueObject>(Point));
+	}
+	Results->SetArrayField(TEXT("Curve"), Curve);
+
+	return Results;
+}
+
+bool FPlayFabBenchmark::RunSocketBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, FOutputDevice& Ar)
+{
+	FPlayFabSocketSubsystem* SocketSubsystem = static_cast<FPlayFabSocketSubsystem*>(ISocketSubsystem::Get(PLAYFAB_SOCKET_SUBSYSTEM));
+	if (OSSPlayFab == nullptr || SocketSubsystem == nullptr)
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark::RunSocketBenchmark: PlayFab socket subsystem is not available"));
+		return false;
+	}
+
+	if (SocketSubsystem->IsCapturingPackets())
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark::RunSocketBenchmark: Stop the packet capture before benchmarking"));
+		return false;
+	}
+
+	Iterations = FMath::Max(Iterations, 1);
+
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("Benchmark"), TEXT("Socket"));
+	Results->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Results->SetNumberField(TEXT("Iterations"), Iterations);
+
+	// The benchmark socket is never registered with the subsystem, so no live traffic reaches it
+	TArray<TSharedPtr<FJsonValue>> QueueCases;
+	const int32 PayloadSizes[] = { 16, 64, 256, 1024 };
+	for (const int32 PayloadSize : PayloadSizes)
+	{
+		FPlayFabSocket Socket(OSSPlayFab, TEXT("PlayFabBenchmark"), FNetworkProtocolTypes::PlayFab);
+		TArray<uint8> Payload;
+		Payload.SetNumZeroed(PayloadSize);
+		TArray<uint8> ReceiveBuffer;
+		ReceiveBuffer.SetNumUninitialized(PayloadSize);
+		FInternetAddrPlayFab SourceAddr;
+
+		uint64 EnqueueCycles = 0;
+		uint64 DrainCycles = 0;
+		int32 Remaining = Iterations;
+		while (Remaining > 0)
+		{
+			int32 BatchCount = 0;
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			while (BatchCount < Remaining && !Socket.PendingPackets.IsFull())
+			{
+				Socket.AddNewPendingData(1, Payload);
+				++BatchCount;
+			}
+			EnqueueCycles += FPlatformTime::Cycles64() - StartCycles;
+
+			int32 BytesRead = 0;
+			StartCycles = FPlatformTime::Cycles64();
+			while (Socket.RecvFrom(ReceiveBuffer.GetData(), ReceiveBuffer.Num(), BytesRead, SourceAddr))
+			{
+			}
+			DrainCycles += FPlatformTime::Cycles64() - StartCycles;
+
+			Remaining -= BatchCount;
+		}
+
+		const double EnqueueSeconds = FPlatformTime::ToSeconds64(EnqueueCycles);
+		const double DrainSeconds = FPlatformTime::ToSeconds64(DrainCycles);
+
+		TSharedPtr<FJsonObject> Case = MakeShared<FJsonObject>();
+		Case->SetNumberField(TEXT("PayloadBytes"), PayloadSize);
+		Case->SetNumberField(TEXT("EnqueueNsPerPacket"), CyclesToNanoseconds(EnqueueCycles) / Iterations);
+		Case->SetNumberField(TEXT("EnqueueBytesPerSecond"), EnqueueSeconds > 0.0 ? (static_cast<double>(Iterations) * PayloadSize) / EnqueueSeconds : 0.0);
+		Case->SetNumberField(TEXT("DrainNsPerPacket"), CyclesToNanoseconds(DrainCycles) / Iterations);
+		Case->SetNumberField(TEXT("DrainPacketsPerSecond"), DrainSeconds > 0.0 ? Iterations / DrainSeconds : 0.0);
+		QueueCases.Add(MakeShared<FJsonValueObject>(Case));
+	}
+	Results->SetArrayField(TEXT("PendingQueue"), QueueCases);
+
+	// Address lookups the way UIpNetDriver maps incoming packets to connections
+	{
+		const int32 AddressCount = FMath::Max(OSSPlayFab->MaxDeviceCount * OSSPlayFab->MaxEndpointsPerDeviceCount, 1);
+		TMap<TSharedRef<const FInternetAddr>, int32, FDefaultSetAllocator, FInternetAddrConstKeyMapFuncs<int32>> AddressMap;
+		TArray<TSharedRef<FInternetAddr>> LookupAddresses;
+		for (int32 AddressIndex = 0; AddressIndex < AddressCount; ++AddressIndex)
+		{
+			AddressMap.Add(MakeShared<FInternetAddrPlayFab>(AddressIndex + 1), AddressIndex);
+			LookupAddresses.Add(MakeShared<FInternetAddrPlayFab>(AddressIndex + 1));
+		}
+
+		int32 Found = 0;
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			if (AddressMap.Find(LookupAddresses[Iteration % AddressCount]))
+			{
+				++Found;
+			}
+		}
+		const uint64 LookupCycles = FPlatformTime::Cycles64() - StartCycles;
+
+		TSharedPtr<FJsonObject> Lookup = MakeShared<FJsonObject>();
+		Lookup->SetNumberField(TEXT("Addresses"), AddressCount);
+		Lookup->SetNumberField(TEXT("NsPerLookup"), CyclesToNanoseconds(LookupCycles) / Iterations);
+		Lookup->SetNumberField(TEXT("Hits"), Found);
+		Results->SetObjectField(TEXT("AddressLookup"), Lookup);
+	}
+
+	// Overflow: the queue must keep the newest packets and drop the oldest
+	{
+		FPlayFabSocket Socket(OSSPlayFab, TEXT("PlayFabBenchmark"), FNetworkProtocolTypes::PlayFab);
+		TArray<uint8> Payload;
+		Payload.SetNumZeroed(64);
+
+		int32 Capacity = 0;
+		while (!Socket.PendingPackets.IsFull())
+		{
+			Socket.AddNewPendingData(static_cast<uint16>(Capacity), Payload);
+			++Capacity;
+		}
+
+		const int32 OverflowCount = FMath::Min(Iterations, static_cast<int32>(MAX_uint16) - Capacity);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Index = 0; Index < OverflowCount; ++Index)
+		{
+			Socket.AddNewPendingData(static_cast<uint16>(Capacity + Index), Payload);
+		}
+		const uint64 OverflowCycles = FPlatformTime::Cycles64() - StartCycles;
+
+		const PartyPacket* OldestPacket = Socket.PendingPackets.Peek();
+		const int32 OldestRetained = OldestPacket ? OldestPacket->SourceEndpoint : INDEX_NONE;
+
+		TSharedPtr<FJsonObject> Overflow = MakeShared<FJsonObject>();
+		Overflow->SetNumberField(TEXT("Capacity"), Capacity);
+		Overflow->SetNumberField(TEXT("OverflowPackets"), OverflowCount);
+		Overflow->SetNumberField(TEXT("NsPerOverflowEnqueue"), OverflowCount > 0 ? CyclesToNanoseconds(OverflowCycles) / OverflowCount : 0.0);
+		Overflow->SetBoolField(TEXT("DropsOldest"), OldestRetained == OverflowCount);
+		Results->SetObjectField(TEXT("QueueOverflow"), Overflow);
+	}
+
+	return WriteResults(TEXT("Socket"), Results, Ar);
+}
+
+// Synthetic results shaped like a server browser page: owner keys, mapped setting keys and custom keys.
+// Number keys hold the lobby index, so range predicates on them select a known share of the lobbies.
+class FPlayFabSyntheticLobbySearchResults
+{
+public:
+	explicit FPlayFabSyntheticLobbySearchResults(int32 LobbyCount)
+	{
+		const TCHAR* StringKeys[] = { TEXT("string_key1"), TEXT("string_key2"), TEXT("string_key30"), TEXT("string_key29"), TEXT("string_key28"), TEXT("string_key5"), TEXT("string_key10"), TEXT("string_key11"), TEXT("string_key12"), TEXT("string_key13") };
+		const TCHAR* NumberKeys[] = { TEXT("number_key30"), TEXT("number_key29"), TEXT("number_key28"), TEXT("number_key27"), TEXT("number_key1"), TEXT("number_key2"), TEXT("number_key3"), TEXT("number_key4"), TEXT("number_key5"), TEXT("number_key6") };
+
+		KeyLists.SetNum(LobbyCount);
+		ValueLists.SetNum(LobbyCount);
+		LobbyIds.SetNum(LobbyCount);
+		Results.SetNumZeroed(LobbyCount);
+		for (int32 LobbyIndex = 0; LobbyIndex < LobbyCount; ++LobbyIndex)
+		{
+			for (const TCHAR* Key : StringKeys)
+			{
+				KeyLists[LobbyIndex].Add(Key);
+				ValueLists[LobbyIndex].Add(FString::Printf(TEXT("%s_value_%d"), Key, LobbyIndex));
+			}
+			for (const TCHAR* Key : NumberKeys)
+			{
+				KeyLists[LobbyIndex].Add(Key);
+				ValueLists[LobbyIndex].Add(FString::FromInt(LobbyIndex));
+			}
+			LobbyIds[LobbyIndex].Add(FString::Printf(TEXT("benchmark-lobby-%d"), LobbyIndex));
+
+			PFLobbySearchResult& LobbySearchResult = Results[LobbyIndex];
+			LobbySearchResult.lobbyId = LobbyIds[LobbyIndex].GetData()[0];
+			LobbySearchResult.connectionString = LobbySearchResult.lobbyId;
+			LobbySearchResult.maxMemberCount = 8;
+			LobbySearchResult.currentMemberCount = 1 + LobbyIndex % 8;
+			LobbySearchResult.searchPropertyCount = KeyLists[LobbyIndex].GetCount();
+			LobbySearchResult.searchPropertyKeys = KeyLists[LobbyIndex].GetData();
+			LobbySearchResult.searchPropertyValues = ValueLists[LobbyIndex].GetData();
+		}
+	}
+
+	FPlayFabSyntheticLobbySearchResults(const FPlayFabSyntheticLobbySearchResults&) = delete;
+	FPlayFabSyntheticLobbySearchResults& operator=(const FPlayFabSyntheticLobbySearchResults&) = delete;
+
+	TArray<PFLobbySearchResult> Results;
+
+private:
+	TArray<UTF8StringList> KeyLists;
+	TArray<UTF8StringList> ValueLists;
+	TArray<UTF8StringList> LobbyIds;
+};
+
+bool FPlayFabBenchmark::RunLobbyResultBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, int32 LobbyCount, FOutputDevice& Ar)
+{
+	FPlayFabLobbyPtr Lobby = OSSPlayFab ? OSSPlayFab->GetPlayFabLobbyInterface() : nullptr;
+	if (!Lobby.IsValid())
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark::RunLobbyResultBenchmark: PlayFab lobby interface is not available"));
+		return false;
+	}
+
+	Iterations = FMath::Max(Iterations, 1);
+	LobbyCount = FMath::Max(LobbyCount, 1);
+
+	const FPlayFabSyntheticLobbySearchResults SyntheticResults(LobbyCount);
+	const TArray<PFLobbySearchResult>& LobbySearchResults = SyntheticResults.Results;
+
+	TArray<FOnlineSessionSearchResult> SearchResults;
+	SearchResults.Reserve(LobbyCount);
+
+	// Warm up so one-time FName registration is not counted
+	for (const PFLobbySearchResult& LobbySearchResult : LobbySearchResults)
+	{
+		SearchResults.Add(Lobby->CreateSearchResultFromLobby(LobbySearchResult));
+	}
+	SearchResults.Reset();
+
+	// Heap allocations are left to Memory Insights (-trace=memalloc,bookmark): the bookmarks bracket the conversion loop
+	// so its allocations can be counted per thread without replacing the global allocator while other threads use it
+	TRACE_BOOKMARK(TEXT("PlayFabBenchmark LobbyResults Begin"));
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		for (const PFLobbySearchResult& LobbySearchResult : LobbySearchResults)
+		{
+			SearchResults.Add(Lobby->CreateSearchResultFromLobby(LobbySearchResult));
+		}
+		SearchResults.Reset();
+	}
+	const uint64 ConvertCycles = FPlatformTime::Cycles64() - StartCycles;
+	TRACE_BOOKMARK(TEXT("PlayFabBenchmark LobbyResults End"));
+
+	const double ConvertedLobbies = static_cast<double>(Iterations) * LobbyCount;
+
+	// Whole result set conversion as HandleFindLobbiesCompleted runs it, serial against chunked on the task graph
+	TArray<FPlayFabLobby::FCachedLobbySearchResult> ConvertedResults;
+	uint64 SerialCycles = 0;
+	uint64 ParallelCycles = 0;
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		uint64 SetStartCycles = FPlatformTime::Cycles64();
+		Lobby->ConvertLobbySearchResults(LobbySearchResults.GetData(), LobbyCount, nullptr, ConvertedResults, false);
+		SerialCycles += FPlatformTime::Cycles64() - SetStartCycles;
+
+		SetStartCycles = FPlatformTime::Cycles64();
+		Lobby->ConvertLobbySearchResults(LobbySearchResults.GetData(), LobbyCount, nullptr, ConvertedResults, true);
+		ParallelCycles += FPlatformTime::Cycles64() - SetStartCycles;
+	}
+
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("Benchmark"), TEXT("LobbyResults"));
+	Results->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Results->SetNumberField(TEXT("Iterations"), Iterations);
+	Results->SetNumberField(TEXT("Lobbies"), LobbyCount);
+	Results->SetNumberField(TEXT("SearchPropertiesPerLobby"), LobbySearchResults[0].searchPropertyCount);
+	Results->SetNumberField(TEXT("NsPerLobby"), CyclesToNanoseconds(ConvertCycles) / ConvertedLobbies);
+	Results->SetNumberField(TEXT("SerialUsPerSearch"), CyclesToNanoseconds(SerialCycles) / 1000.0 / Iterations);
+	Results->SetNumberField(TEXT("ParallelUsPerSearch"), CyclesToNanoseconds(ParallelCycles) / 1000.0 / Iterations);
+	Results->SetBoolField(TEXT("ParallelConversionEnabled"), Lobby->bEnableParallelSearchConversion);
+	Results->SetNumberField(TEXT("ConversionChunkSize"), Lobby->LobbySearchConversionChunkSize);
+
+	return WriteResults(TEXT("LobbyResults"), Results, Ar);
+}
+
+bool FPlayFabBenchmark::RunSearchKeyBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, int32 LobbyCount, FOutputDevice& Ar)
+{
+	FPlayFabLobbyPtr Lobby = OSSPlayFab ? OSSPlayFab->GetPlayFabLobbyInterface() : nullptr;
+	if (!Lobby.IsValid())
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark::RunSearchKeyBenchmark: PlayFab lobby interface is not available"));
+		return false;
+	}
+
+	Iterations = FMath::Max(Iterations, 1);
+	LobbyCount = FMath::Max(LobbyCount, 1);
+
+	// Setting to search key resolution, as done for every setting on lobby create and update and every search parameter
+	const FName SettingNames[] = { SETTING_MAPNAME, SETTING_GAMEMODE, SETTING_REGION, SETTING_HOST_NICKNAME, SETTING_NUMBOTS, SETTING_QOS, SEARCH_MINSLOTSAVAILABLE, SEARCH_LOBBIES, FName(TEXT("BENCHMARK_UNMAPPED_SETTING")) };
+	int32 ResolvedCount = 0;
+	const uint64 LookupStartCycles = FPlatformTime::Cycles64();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		for (const FName& SettingName : SettingNames)
+		{
+			ResolvedCount += Lobby->FindSearchKeyForSetting(SettingName) != nullptr ? 1 : 0;
+		}
+	}
+	const uint64 LookupCycles = FPlatformTime::Cycles64() - LookupStartCycles;
+
+	// A range predicate on a number key, e.g. NUMBOTS >= 3/4 of the lobby count. Without it every lobby is transferred and
+	// converted, then filtered on the client; with it the service only returns the lobbies the predicate matches.
+	// The service is simulated here by selecting those lobbies from the synthetic set.
+	const FPlayFabLobby::FSettingSearchKey* RangeSearchKey = Lobby->FindSearchKeyForSetting(SETTING_NUMBOTS);
+	if (RangeSearchKey == nullptr || RangeSearchKey->Type == EOnlineKeyValuePairDataType::String)
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark::RunSearchKeyBenchmark: %s is not mapped to a number key"), *SETTING_NUMBOTS.ToString());
+		return false;
+	}
+
+	const FPlayFabSyntheticLobbySearchResults SyntheticResults(LobbyCount);
+	const int32 RangeThreshold = LobbyCount * 3 / 4;
+	FString EncodedThreshold;
+	FPlayFabLobby::EncodeSearchPropertyValue(FVariantData(RangeThreshold), RangeSearchKey->Type, EncodedThreshold);
+	const FTCHARToUTF8 RangeKey(*RangeSearchKey->SearchKey);
+
+	TArray<PFLobbySearchResult> MatchingLobbies;
+	for (const PFLobbySearchResult& LobbySearchResult : SyntheticResults.Results)
+	{
+		for (uint32 PropertyIndex = 0; PropertyIndex < LobbySearchResult.searchPropertyCount; ++PropertyIndex)
+		{
+			if (FCStringAnsi::Strcmp(LobbySearchResult.searchPropertyKeys[PropertyIndex], RangeKey.Get()) == 0 &&
+				FCStringAnsi::Atod(LobbySearchResult.searchPropertyValues[PropertyIndex]) >= FCString::Atod(*EncodedThreshold))
+			{
+				MatchingLobbies.Add(LobbySearchResult);
+				break;
+			}
+		}
+	}
+
+	TArray<FPlayFabLobby::FCachedLobbySearchResult> ConvertedResults;
+	uint64 ClientFilterCycles = 0;
+	uint64 ServiceFilterCycles = 0;
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		uint64 SetStartCycles = FPlatformTime::Cycles64();
+		Lobby->ConvertLobbySearchResults(SyntheticResults.Results.GetData(), SyntheticResults.Results.Num(), nullptr, ConvertedResults, false);
+		ClientFilterCycles += FPlatformTime::Cycles64() - SetStartCycles;
+
+		SetStartCycles = FPlatformTime::Cycles64();
+		Lobby->ConvertLobbySearchResults(MatchingLobbies.GetData(), MatchingLobbies.Num(), nullptr, ConvertedResults, false);
+		ServiceFilterCycles += FPlatformTime::Cycles64() - SetStartCycles;
+	}
+
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("Benchmark"), TEXT("SearchKeys"));
+	Results->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Results->SetNumberField(TEXT("Iterations"), Iterations);
+	Results->SetNumberField(TEXT("Lobbies"), LobbyCount);
+	Results->SetNumberField(TEXT("NsPerSettingLookup"), CyclesToNanoseconds(LookupCycles) / (static_cast<double>(Iterations) * UE_ARRAY_COUNT(SettingNames)));
+	Results->SetNumberField(TEXT("ResolvedSettingsPerIteration"), static_cast<double>(ResolvedCount) / Iterations);
+	Results->SetStringField(TEXT("RangePredicate"), FString::Printf(TEXT("%s ge %s"), *RangeSearchKey->SearchKey, *EncodedThreshold));
+	Results->SetNumberField(TEXT("LobbiesTransferredClientFilter"), SyntheticResults.Results.Num());
+	Results->SetNumberField(TEXT("LobbiesTransferredServiceFilter"), MatchingLobbies.Num());
+	Results->SetNumberField(TEXT("ClientFilterConvertUsPerSearch"), CyclesToNanoseconds(ClientFilterCycles) / 1000.0 / Iterations);
+	Results->SetNumberField(TEXT("ServiceFilterConvertUsPerSearch"), CyclesToNanoseconds(ServiceFilterCycles) / 1000.0 / Iterations);
+
+	return WriteResults(TEXT("SearchKeys"), Results, Ar);
+}
+
+bool FPlayFabBenchmark::WriteTickProfile(const FPlayFabTickProfiler& Profiler, FOutputDevice& Ar)
+{
+	return WriteResults(TEXT("Ticks"), Profiler.BuildResults(), Ar);
+}
+
+bool FPlayFabBenchmark::WriteResults(const FString& BenchmarkName, TSharedRef<FJsonObject> Results, FOutputDevice& Ar)
+{
+	const FString ResultsJson = SerializeRequestJson(Results);
+	const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("PlayFab"), FString::Printf(TEXT("%sBenchmark_%s.json"), *BenchmarkName, *FDateTime::Now().ToString()));
+
+	Ar.Logf(TEXT("%s"), *ResultsJson);
+	if (!FFileHelper::SaveStringToFile(ResultsJson, *Filename))
+	{
+		Ar.Logf(TEXT("FPlayFabBenchmark: Failed to write %s"), *Filename);
+		return false;
+	}
+
+	Ar.Logf(TEXT("FPlayFabBenchmark: Results written to %s"), *Filename);
+	return true;
+}
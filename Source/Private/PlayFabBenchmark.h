@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+class FOnlineSubsystemPlayFab;
+class FOutputDevice;
+class FPlayFabTickProfiler;
+
+enum class EPlayFabTickPhase : uint8
+{
+	PartyDoWork,
+	SocketTick,
+	VoiceTick,
+	SessionTick,
+	LobbyDoWork,
+	MatchmakingDoWork,
+	Count
+};
+
+const TCHAR* LexToString(EPlayFabTickPhase Phase);
+
+/**
+ * Accumulates game-thread cost of each PlayFab tick phase, bucketed by the number of Party endpoints
+ * in the network at the time, so cost can be read as a curve against network size.
+ */
+class FPlayFabTickProfiler
+{
+public:
+	void Start();
+	void Stop() { bRunning = false; }
+	bool IsRunning() const { return bRunning; }
+
+	void AddSample(EPlayFabTickPhase Phase, int32 EndpointCount, uint64 Cycles);
+
+	TSharedRef<FJsonObject> BuildResults() const;
+
+private:
+	struct FPhaseSamples
+	{
+		uint64 TotalCycles = 0;
+		uint64 MaxCycles = 0;
+		uint32 SampleCount = 0;
+	};
+
+	struct FEndpointCountBucket
+	{
+		FPhaseSamples Phases[static_cast<uint8>(EPlayFabTickPhase::Count)];
+	};
+
+	TMap<int32, FEndpointCountBucket> Buckets;
+	double StartTime = 0.0;
+	bool bRunning = false;
+};
+
+/** Times the enclosing scope into a tick profiler, does nothing while the profiler is stopped */
+class FPlayFabScopedTickSample
+{
+public:
+	FPlayFabScopedTickSample(FPlayFabTickProfiler* InProfiler, EPlayFabTickPhase InPhase, int32 InEndpointCount) :
+		Profiler(InProfiler && InProfiler->IsRunning() ? InProfiler : nullptr),
+		Phase(InPhase),
+		EndpointCount(InEndpointCount),
+		StartCycles(Profiler ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FPlayFabScopedTickSample()
+	{
+		if (Profiler)
+		{
+			Profiler->AddSample(Phase, EndpointCount, FPlatformTime::Cycles64() - StartCycles);
+		}
+	}
+
+private:
+	FPlayFabTickProfiler* Profiler;
+	EPlayFabTickPhase Phase;
+	int32 EndpointCount;
+	uint64 StartCycles;
+};
+
+/**
+ * In-process micro-benchmarks, run through the PLAYFAB BENCHMARK console command.
+ * Results are logged and written as JSON under Saved/PlayFab so they can be compared between builds.
+ */
+class FPlayFabBenchmark
+{
+public:
+	// Packet path cost of FPlayFabSocket: pending queue enqueue/drain by payload size, address map lookups and queue overflow
+	static bool RunSocketBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, FOutputDevice& Ar);
+
+	// Cost of converting lobby search results into session search results, allocations are read from a memory trace
+	static bool RunLobbyResultBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, int32 LobbyCount, FOutputDevice& Ar);
+
+	// Setting to search key resolution, and results transferred and converted with a range predicate evaluated by the service or the client
+	static bool RunSearchKeyBenchmark(FOnlineSubsystemPlayFab* OSSPlayFab, int32 Iterations, int32 LobbyCount, FOutputDevice& Ar);
+
+	// Per-phase tick cost collected by PLAYFAB BENCHMARK TICKS START since the profiler was started
+	static bool WriteTickProfile(const FPlayFabTickProfiler& Profiler, FOutputDevice& Ar);
+
+	// Prints Results and saves them to Saved/PlayFab/<BenchmarkName>Benchmark_<time>.json
+	static bool WriteResults(const FString& BenchmarkName, TSharedRef<FJsonObject> Results, FOutputDevice& Ar);
+};
@@ -0,0 +1,155 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PlayFabJoinTimeline.h"
+#include "OnlineSubsystemPlayFab.h"
+
+#include "Misc/MiscTrace.h"
+
+const TCHAR* LexToString(EPlayFabJoinPhase Phase)
+{
+	switch (Phase)
+	{
+	case EPlayFabJoinPhase::LobbyJoined:				return TEXT("LobbyJoined");
+	case EPlayFabJoinPhase::NetworkConnectRequested:	return TEXT("NetworkConnectRequested");
+	case EPlayFabJoinPhase::NetworkConnected:			return TEXT("NetworkConnected");
+	case EPlayFabJoinPhase::EndpointCreated:			return TEXT("EndpointCreated");
+	default:											return TEXT("Unknown");
+	}
+}
+
+FPlayFabJoinTimeline::FPlayFabJoinTimeline()
+{
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("JoinTimelineSampleCount"), MaxSamples, GEngineIni);
+	MaxSamples = FMath::Max(MaxSamples, 1);
+
+	FMemory::Memzero(PhaseSeconds);
+}
+
+void FPlayFabJoinTimeline::Begin(FName SessionName, const TCHAR* JoinType)
+{
+	if (bActive)
+	{
+		UE_LOG_ONLINE(Log, TEXT("FPlayFabJoinTimeline: Join %u for %s abandoned after %.3fs"), CorrelationId, *ActiveSessionName.ToString(), FPlatformTime::Seconds() - StartTime);
+		AbandonedJoins++;
+	}
+
+	ActiveSessionName = SessionName;
+	ActiveJoinType = JoinType;
+	StartTime = FPlatformTime::Seconds();
+	LastPhaseTime = StartTime;
+	FMemory::Memzero(PhaseSeconds);
+	CorrelationId++;
+	bActive = true;
+
+	TRACE_BOOKMARK(TEXT("PlayFabJoin %u Begin %s"), CorrelationId, JoinType);
+}
+
+void FPlayFabJoinTimeline::MarkPhase(EPlayFabJoinPhase Phase)
+{
+	const uint8 PhaseIndex = static_cast<uint8>(Phase);
+	if (!bActive || PhaseSeconds[PhaseIndex] > 0.0)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	// Never report a zero duration, it marks the phase as not reached
+	PhaseSeconds[PhaseIndex] = FMath::Max(Now - LastPhaseTime, SMALL_NUMBER);
+	LastPhaseTime = Now;
+
+	TRACE_BOOKMARK(TEXT("PlayFabJoin %u %s"), CorrelationId, LexToString(Phase));
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabJoinTimeline: Join %u reached %s after %.3fs"), CorrelationId, LexToString(Phase), PhaseSeconds[PhaseIndex]);
+}
+
+void FPlayFabJoinTimeline::Finish(bool bSuccess)
+{
+	if (!bActive)
+	{
+		return;
+	}
+	bActive = false;
+
+	const double TotalSeconds = FPlatformTime::Seconds() - StartTime;
+	TRACE_BOOKMARK(TEXT("PlayFabJoin %u %s"), CorrelationId, bSuccess ? TEXT("Succeeded") : TEXT("Failed"));
+
+	FString PhaseSummary;
+	for (uint8 PhaseIndex = 0; PhaseIndex < static_cast<uint8>(EPlayFabJoinPhase::Count); ++PhaseIndex)
+	{
+		PhaseSummary += FString::Printf(TEXT(" %s=%.3fs"), LexToString(static_cast<EPlayFabJoinPhase>(PhaseIndex)), PhaseSeconds[PhaseIndex]);
+	}
+	UE_LOG_ONLINE(Log, TEXT("FPlayFabJoinTimeline: %s join %u for %s %s in %.3fs:%s"),
+		*ActiveJoinType, CorrelationId, *ActiveSessionName.ToString(), bSuccess ? TEXT("succeeded") : TEXT("failed"), TotalSeconds, *PhaseSummary);
+
+	if (!bSuccess)
+	{
+		FailedJoins++;
+		return;
+	}
+
+	SucceededJoins++;
+	AddSample(TotalHistory, TotalSeconds);
+	for (uint8 PhaseIndex = 0; PhaseIndex < static_cast<uint8>(EPlayFabJoinPhase::Count); ++PhaseIndex)
+	{
+		// The host creates the network instead of joining a lobby first, so not every phase is reached
+		if (PhaseSeconds[PhaseIndex] > 0.0)
+		{
+			AddSample(PhaseHistory[PhaseIndex], PhaseSeconds[PhaseIndex]);
+		}
+	}
+}
+
+void FPlayFabJoinTimeline::AddSample(FPhaseSamples& PhaseSamples, float Seconds)
+{
+	if (PhaseSamples.Samples.Num() < MaxSamples)
+	{
+		PhaseSamples.Samples.Add(Seconds);
+	}
+	else
+	{
+		PhaseSamples.Samples[PhaseSamples.NextSampleIndex] = Seconds;
+		PhaseSamples.NextSampleIndex = (PhaseSamples.NextSampleIndex + 1) % MaxSamples;
+	}
+}
+
+TSharedPtr<FJsonObject> FPlayFabJoinTimeline::BuildPercentiles(const FPhaseSamples& PhaseSamples)
+{
+	TArray<float> Sorted = PhaseSamples.Samples;
+	Sorted.Sort();
+
+	auto Percentile = [&Sorted](float Fraction)
+	{
+		return Sorted[FMath::Clamp(FMath::CeilToInt(Fraction * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+	};
+
+	TSharedPtr<FJsonObject> Object = MakeShared<FJsonObject>();
+	Object->SetNumberField(TEXT("Samples"), Sorted.Num());
+	if (Sorted.Num() > 0)
+	{
+		Object->SetNumberField(TEXT("P50"), Percentile(0.5f));
+		Object->SetNumberField(TEXT("P90"), Percentile(0.9f));
+		Object->SetNumberField(TEXT("P99"), Percentile(0.99f));
+		Object->SetNumberField(TEXT("Max"), Sorted.Last());
+	}
+	return Object;
+}
+
+TSharedRef<FJsonObject> FPlayFabJoinTimeline::BuildReport() const
+{
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Report->SetNumberField(TEXT("SucceededJoins"), SucceededJoins);
+	Report->SetNumberField(TEXT("FailedJoins"), FailedJoins);
+	Report->SetNumberField(TEXT("AbandonedJoins"), AbandonedJoins);
+	Report->SetObjectField(TEXT("TotalSeconds"), BuildPercentiles(TotalHistory));
+
+	TSharedPtr<FJsonObject> Phases = MakeShared<FJsonObject>();
+	for (uint8 PhaseIndex = 0; PhaseIndex < static_cast<uint8>(EPlayFabJoinPhase::Count); ++PhaseIndex)
+	{
+		Phases->SetObjectField(LexToString(static_cast<EPlayFabJoinPhase>(PhaseIndex)), BuildPercentiles(PhaseHistory[PhaseIndex]));
+	}
+	Report->SetObjectField(TEXT("PhaseSeconds"), Phases);
+
+	return Report;
+}
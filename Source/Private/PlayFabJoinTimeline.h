@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+// Phases of a join in the order they normally happen, each one is timed from the previous phase that was reached
+enum class EPlayFabJoinPhase : uint8
+{
+	LobbyJoined,				// JoinLobbyCompleted / JoinArrangedLobbyCompleted
+	NetworkConnectRequested,	// network descriptor available, ConnectToNetwork issued
+	NetworkConnected,			// ConnectToNetworkCompleted
+	EndpointCreated,			// local endpoint ready, NMT_Hello can flow
+	Count
+};
+
+const TCHAR* LexToString(EPlayFabJoinPhase Phase);
+
+/**
+ * Timestamps the phases of the current lobby or matchmaking join under a correlation id and keeps
+ * the most recent phase durations of successful joins so percentiles can be reported.
+ */
+class FPlayFabJoinTimeline
+{
+public:
+	FPlayFabJoinTimeline();
+
+	// Starts a new span, an unfinished previous span is counted as abandoned
+	void Begin(FName SessionName, const TCHAR* JoinType);
+	void MarkPhase(EPlayFabJoinPhase Phase);
+	void Finish(bool bSuccess);
+
+	bool IsActive() const { return bActive; }
+	uint32 GetCorrelationId() const { return CorrelationId; }
+
+	TSharedRef<FJsonObject> BuildReport() const;
+
+private:
+	struct FPhaseSamples
+	{
+		TArray<float> Samples;
+		int32 NextSampleIndex = 0;
+	};
+
+	void AddSample(FPhaseSamples& PhaseSamples, float Seconds);
+	static TSharedPtr<FJsonObject> BuildPercentiles(const FPhaseSamples& PhaseSamples);
+
+	FName ActiveSessionName;
+	FString ActiveJoinType;
+	double StartTime = 0.0;
+	double LastPhaseTime = 0.0;
+	double PhaseSeconds[static_cast<uint8>(EPlayFabJoinPhase::Count)];
+	uint32 CorrelationId = 0;
+	bool bActive = false;
+
+	FPhaseSamples PhaseHistory[static_cast<uint8>(EPlayFabJoinPhase::Count)];
+	FPhaseSamples TotalHistory;
+	int32 MaxSamples = 128;
+	uint32 SucceededJoins = 0;
+	uint32 FailedJoins = 0;
+	uint32 AbandonedJoins = 0;
+};
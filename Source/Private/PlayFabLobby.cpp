@@ -7,7 +7,11 @@
 #include "PlayFabHelpers.h"
 #include "OnlineSubsystemPlayFab.h"
 #include "OnlineSessionInterfacePlayFab.h"
+#include "PlayFabStateChangeTrace.h"
+#include "PlayFabJoinTimeline.h"
 #include "Online/OnlineSessionNames.h"
+#include "Async/ParallelFor.h"
+#include "Algo/StableSort.h"
 
 static struct FSearchKeyMappingTable
 {
@@ -76,6 +80,32 @@ FPlayFabLobby::FPlayFabLobby(FOnlineSubsystemPlayFab* InOSSPlayFab) :
 	OSSPlayFab(InOSSPlayFab)
 {
 	BuildSearchKeyMappingTable();
+
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableDeltaLobbyUpdates"), bEnableDeltaLobbyUpdates, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("LobbyUpdateCoalesceWindow"), LobbyUpdateCoalesceWindow, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("LobbyUpdateMinInterval"), LobbyUpdateMinInterval, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("SearchFilterCacheMaxEntries"), SearchFilterCacheMaxEntries, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("LobbySearchCacheTTL"), LobbySearchCacheTTL, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("LobbySearchCacheStaleTime"), LobbySearchCacheStaleTime, GEngineIni);
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableParallelSearchConversion"), bEnableParallelSearchConversion, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("LobbySearchConversionChunkSize"), LobbySearchConversionChunkSize, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("SearchRankLatencyWeight"), SearchRankLatencyWeight, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("SearchRankFillWeight"), SearchRankFillWeight, GEngineIni);
+
+	// Numeric settings that add to the rank score, e.g. +SearchRankSettingWeights=(Setting=SKILL,Weight=-0.5)
+	TArray<FString> SettingWeights;
+	GConfig->GetArray(TEXT("OnlineSubsystemPlayFab"), TEXT("SearchRankSettingWeights"), SettingWeights, GEngineIni);
+	for (const FString& SettingWeight : SettingWeights)
+	{
+		FString SettingName;
+		float Weight = 0.0f;
+		if (!FParse::Value(*SettingWeight, TEXT("Setting="), SettingName) || !FParse::Value(*SettingWeight, TEXT("Weight="), Weight))
+		{
+			UE_LOG_ONLINE(Error, TEXT("Engine INI OnlineSubsystemPlayFab section contains erroneous value for key SearchRankSettingWeights: %s"), *SettingWeight);
+			continue;
+		}
+		SearchRankSettingWeights.Add(FName(*SettingName), Weight);
+	}
 }
 
 bool FPlayFabLobby::CreatePlayFabLobby(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
@@ -111,6 +141,12 @@ bool FPlayFabLobby::CreateLobbyWithUser(const FUniqueNetId& HostingPlayerId, FNa
 	FString PlayerNickName = PlayFabIdentityInt->GetPlayerNickname(HostingPlayerId);
 	UpdateSessionSettings.Set(SETTING_HOST_NICKNAME, PlayerNickName, EOnlineDataAdvertisementType::ViaOnlineService);
 
+	FString HostRegion;
+	if (bEnableLatencyRankedSearch && GetHostRegion(HostRegion))
+	{
+		UpdateSessionSettings.Set(SETTING_HOST_REGION, HostRegion, EOnlineDataAdvertisementType::ViaOnlineService);
+	}
+
 	LobbyCreateConfig.maxMemberCount = UpdateSessionSettings.NumPublicConnections;
 	LobbyCreateConfig.ownerMigrationPolicy = PFLobbyOwnerMigrationPolicy::Automatic;
 	LobbyCreateConfig.accessPolicy = PFLobbyAccessPolicy::Private;
@@ -180,30 +216,18 @@ bool FPlayFabLobby::CreateLobbyWithUser(const FUniqueNetId& HostingPlayerId, FNa
 				SearchValues.Add(SettingValueString);
 			}
 		}
-		else
+		else if (const FSettingSearchKey* SettingSearchKey = FindSearchKeyForSetting(SettingName))
 		{
-			FString SearchKey;
-			EOnlineKeyValuePairDataType::Type Type;
-			if (GetSearchKeyFromSettingMappingTable(SettingNameString, SearchKey, Type))
+			FString SearchValue;
+			if (EncodeSearchPropertyValue(SettingValue.Data, SettingSearchKey->Type, SearchValue))
 			{
-				UE_LOG_ONLINE(Verbose, TEXT("CreateLobbyWithUser: predefined item %s(%s): %s Type: %d."), *SettingNameString, *SearchKey, *SettingValueString, Type);
-				switch (Type)
-				{
-				case EOnlineKeyValuePairDataType::Bool:
-				{
-					const FVariantData& VariantData = SettingValue.Data;
-					bool BoolVal;
-					VariantData.GetValue(BoolVal);
-					SearchKeys.Add(TCHAR_TO_UTF8(*SearchKey));
-					SearchValues.Add(BoolVal == true ? "1" : "0");
-					break;
-				}
-				case EOnlineKeyValuePairDataType::Int32:
-				case EOnlineKeyValuePairDataType::String:
-					SearchKeys.Add(TCHAR_TO_UTF8(*SearchKey));
-					SearchValues.Add(SettingValueString);
-					break;
-				}
+				UE_LOG_ONLINE(Verbose, TEXT("CreateLobbyWithUser: predefined item %s(%s): %s Type: %d."), *SettingNameString, *SettingSearchKey->SearchKey, *SearchValue, SettingSearchKey->Type);
+				SearchKeys.Add(SettingSearchKey->SearchKey);
+				SearchValues.Add(SearchValue);
+			}
+			else
+			{
+				UE_LOG_ONLINE(Warning, TEXT("CreateLobbyWithUser: %s value %s cannot be stored as %s, it is not searchable."), *SettingNameString, *SettingValueString, EOnlineKeyValuePairDataType::ToString(SettingSearchKey->Type));
 			}
 		}
 	}
@@ -246,6 +270,12 @@ bool FPlayFabLobby::CreateLobbyWithUser(const FUniqueNetId& HostingPlayerId, FNa
 	LobbyCreateConfig.searchPropertyKeys = SearchKeys.GetData();
 	LobbyCreateConfig.searchPropertyValues = SearchValues.GetData();
 
+	if (!ValidateMaxMemberCount(TEXT("CreateLobbyWithUser"), LobbyCreateConfig.maxMemberCount) ||
+		!ValidatePropertyLimits(TEXT("CreateLobbyWithUser"), LobbyCreateConfig.lobbyPropertyCount, LobbyCreateConfig.searchPropertyCount, LobbyJoinConfig.memberPropertyCount))
+	{
+		return false;
+	}
+
 	PFEntityKey EntityKey = LocalUser->GetEntityKey();
 	HRESULT Hr = PFMultiplayerCreateAndJoinLobby(OSSPlayFab->GetMultiplayerHandle(), &EntityKey, &LobbyCreateConfig, &LobbyJoinConfig, nullptr, &LobbyHandle);
 	if (FAILED(Hr))
@@ -320,6 +350,11 @@ bool FPlayFabLobby::JoinLobbyWithUser(const FUniqueNetId& UserId, FName SessionN
 	LobbyConfig.memberPropertyKeys = MemberKeys.GetData();
 	LobbyConfig.memberPropertyValues = MemberValues.GetData();
 
+	if (!ValidatePropertyLimits(TEXT("JoinLobbyWithUser"), 0, 0, LobbyConfig.memberPropertyCount))
+	{
+		return false;
+	}
+
 	FString ConnectionString;
 	if ((SessionSettings.Get(SETTING_CONNECTION_STRING, ConnectionString)) == false)
 	{
@@ -335,6 +370,7 @@ bool FPlayFabLobby::JoinLobbyWithUser(const FUniqueNetId& UserId, FName SessionN
 		return false;
 	}
 	LobbySessionMap.Add(LobbyHandle, SessionName);
+	OSSPlayFab->GetJoinTimeline()->Begin(SessionName, TEXT("Lobby"));
 
 	return true;
 }
@@ -404,6 +440,12 @@ bool FPlayFabLobby::JoinArrangedLobby(FName SessionName, const FOnlineMatchmakin
 	LobbyConfig.memberPropertyKeys = MemberKeys.GetData();
 	LobbyConfig.memberPropertyValues = MemberValues.GetData();
 
+	if (!ValidateMaxMemberCount(TEXT("JoinArrangedLobby"), LobbyConfig.maxMemberCount) ||
+		!ValidatePropertyLimits(TEXT("JoinArrangedLobby"), 0, 0, LobbyConfig.memberPropertyCount))
+	{
+		return false;
+	}
+
 	PFEntityKey EntityKey = MatchTicket->GetHostUser()->GetEntityKey();
 	TUniquePtr<FString> LocalPlayerNickName = MakeUnique<FString>(PlayerNickName);
 	HRESULT Hr = PFMultiplayerJoinArrangedLobby(OSSPlayFab->GetMultiplayerHandle(), &EntityKey, MatchTicket->PlayFabMatchmakingDetails->lobbyArrangementString, &LobbyConfig, static_cast<void*>(LocalPlayerNickName.Release()), &LobbyHandle);
@@ -413,11 +455,204 @@ bool FPlayFabLobby::JoinArrangedLobby(FName SessionName, const FOnlineMatchmakin
 		return false;
 	}
 	LobbySessionMap.Add(LobbyHandle, SessionName);
+	OSSPlayFab->GetJoinTimeline()->Begin(SessionName, TEXT("Matchmaking"));
+
+	return true;
+}
+
+bool FPlayFabLobby::IsSameEntity(const PFEntityKey& A, const PFEntityKey& B)
+{
+	return FCStringAnsi::Strcmp(A.id, B.id) == 0 && FCStringAnsi::Strcmp(A.type, B.type) == 0;
+}
+
+void* FPlayFabLobby::MakeOperationContext(int OperationId)
+{
+	// The operation id travels by value in the async context, offset so it is never null
+	return reinterpret_cast<void*>(static_cast<UPTRINT>(OperationId) + 1);
+}
+
+int FPlayFabLobby::GetOperationContextId(void* AsyncContext)
+{
+	return static_cast<int>(reinterpret_cast<UPTRINT>(AsyncContext) - 1);
+}
+
+void FPlayFabLobby::AppendPropertyDelta(const TCHAR* PropertyType, const TMap<FString, FString>& Properties, TMap<FString, uint32>& PostedProperties, bool bFullUpload, UTF8StringList& Keys, UTF8StringList& Values, FLobbyUpdateDeltaStats& Stats)
+{
+	if (bFullUpload)
+	{
+		PostedProperties.Reset();
+	}
+
+	for (const TPair<FString, FString>& Property : Properties)
+	{
+		if (Property.Value.IsEmpty())
+		{
+			// Empty values are posted as null, which removes the key from the lobby
+			if (PostedProperties.Remove(Property.Key) > 0 || bFullUpload)
+			{
+				UE_LOG_ONLINE(Warning, TEXT("UpdateLobby %s Property: %s: <Empty>."), PropertyType, *Property.Key);
+				Keys.Add(Property.Key);
+				Values.AddNull();
+				Stats.KeysSent++;
+				Stats.BytesSent += FTCHARToUTF8(*Property.Key).Length();
+			}
+			else
+			{
+				Stats.KeysSkipped++;
+			}
+			continue;
+		}
+
+		const uint32 ValueHash = FCrc::StrCrc32(*Property.Value);
+		const uint32* PostedHash = PostedProperties.Find(Property.Key);
+		if (bFullUpload || PostedHash == nullptr || *PostedHash != ValueHash)
+		{
+			UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby %s Property: %s: %s."), PropertyType, *Property.Key, *Property.Value);
+			Keys.Add(Property.Key);
+			Values.Add(Property.Value);
+			PostedProperties.Add(Property.Key, ValueHash);
+			Stats.KeysSent++;
+			Stats.BytesSent += FTCHARToUTF8(*Property.Key).Length() + FTCHARToUTF8(*Property.Value).Length();
+		}
+		else
+		{
+			Stats.KeysSkipped++;
+		}
+	}
+
+	// Settings removed since the last update are deleted from the lobby
+	for (auto It = PostedProperties.CreateIterator(); It; ++It)
+	{
+		if (!Properties.Contains(It.Key()))
+		{
+			UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby %s Property: %s: <Removed>."), PropertyType, *It.Key());
+			Keys.Add(It.Key());
+			Values.AddNull();
+			Stats.KeysSent++;
+			Stats.KeysDeleted++;
+			Stats.BytesSent += FTCHARToUTF8(*It.Key()).Length();
+			It.RemoveCurrent();
+		}
+	}
+}
+
+bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings, bool bPostImmediately)
+{
+	PFLobbyHandle LobbyHandle = nullptr;
+	if (!GetLobbyFromSession(SessionName, LobbyHandle))
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::UpdateLobby: No lobby found for session %s!"), *(SessionName.ToString()));
+		return false;
+	}
+
+	FLobbyUpdateSchedule& Schedule = LobbyUpdateSchedules.FindOrAdd(SessionName);
+	const double Now = FPlatformTime::Seconds();
+
+	// Post straight away when coalescing is off and nothing is queued or in flight, so failures are still reported to the caller
+	const bool bPacingAllowsPost = bPostImmediately || (LobbyUpdateCoalesceWindow <= 0.0f && Now - Schedule.LastPostTime >= LobbyUpdateMinInterval);
+	if (bPacingAllowsPost && !Schedule.PendingSettings.IsSet() && Schedule.InFlightCallers == 0)
+	{
+		if (!InternalUpdateLobby(SessionName, SessionSettings))
+		{
+			return false;
+		}
+		Schedule.InFlightCallers = 1;
+		Schedule.LastPostTime = Now;
+		return true;
+	}
+
+	if (Schedule.PendingSettings.IsSet())
+	{
+		LobbyUpdateCallsMerged++;
+	}
+	else
+	{
+		Schedule.PendingSince = Now;
+	}
+	Schedule.PendingSettings = SessionSettings;
+	Schedule.PendingCallers++;
+	Schedule.bPostPendingImmediately |= bPostImmediately;
 
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::UpdateLobby: Queued update for session %s, %d callers waiting"), *SessionName.ToString(), Schedule.PendingCallers);
 	return true;
 }
 
-bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings)
+void FPlayFabLobby::TickLobbyUpdateSchedules()
+{
+	const double Now = FPlatformTime::Seconds();
+	TArray<TPair<FName, int32>> FailedUpdates;
+
+	for (TPair<FName, FLobbyUpdateSchedule>& Entry : LobbyUpdateSchedules)
+	{
+		FLobbyUpdateSchedule& Schedule = Entry.Value;
+		if (!Schedule.PendingSettings.IsSet() || Schedule.InFlightCallers > 0)
+		{
+			continue;
+		}
+
+		if (!Schedule.bPostPendingImmediately && (Now - Schedule.PendingSince < LobbyUpdateCoalesceWindow || Now - Schedule.LastPostTime < LobbyUpdateMinInterval))
+		{
+			continue;
+		}
+
+		const FOnlineSessionSettings SessionSettings = MoveTemp(Schedule.PendingSettings.GetValue());
+		const int32 Callers = Schedule.PendingCallers;
+		Schedule.PendingSettings.Reset();
+		Schedule.PendingCallers = 0;
+		Schedule.bPostPendingImmediately = false;
+
+		if (InternalUpdateLobby(Entry.Key, SessionSettings))
+		{
+			Schedule.InFlightCallers = Callers;
+			Schedule.LastPostTime = Now;
+		}
+		else
+		{
+			FailedUpdates.Emplace(Entry.Key, Callers);
+		}
+	}
+
+	// Completion handlers may queue another update, so they run after the schedules have been walked
+	for (const TPair<FName, int32>& FailedUpdate : FailedUpdates)
+	{
+		for (int32 i = 0; i < FailedUpdate.Value; ++i)
+		{
+			TriggerOnUpdateLobbyCompletedDelegates(FailedUpdate.Key, false);
+		}
+	}
+}
+
+void FPlayFabLobby::CompleteLobbyUpdate(FName SessionName, bool bWasSuccessful)
+{
+	int32 Callers = 1;
+	if (FLobbyUpdateSchedule* Schedule = LobbyUpdateSchedules.Find(SessionName))
+	{
+		Callers = FMath::Max(Schedule->InFlightCallers, 1);
+		Schedule->InFlightCallers = 0;
+	}
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::CompleteLobbyUpdate: Session %s update completed for %d callers. %u calls merged and %u posts issued so far"),
+		*SessionName.ToString(), Callers, LobbyUpdateCallsMerged, LobbyUpdatePostCount);
+
+	for (int32 i = 0; i < Callers; ++i)
+	{
+		TriggerOnUpdateLobbyCompletedDelegates(SessionName, bWasSuccessful);
+	}
+}
+
+void FPlayFabLobby::CancelLobbyUpdates(FName SessionName)
+{
+	FLobbyUpdateSchedule Schedule;
+	if (LobbyUpdateSchedules.RemoveAndCopyValue(SessionName, Schedule))
+	{
+		for (int32 i = 0; i < Schedule.PendingCallers; ++i)
+		{
+			TriggerOnUpdateLobbyCompletedDelegates(SessionName, false);
+		}
+	}
+}
+
+bool FPlayFabLobby::InternalUpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings)
 {
 	int OperationId = NextUpdateLobbyOperationId;
 	NextUpdateLobbyOperationId.fetch_add(1);
@@ -440,8 +675,26 @@ bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings&
 
 	FUpdateLobbyCompletionState UpdateLobbyCompletionState;
 	UpdateLobbyCompletionState.LobbyPostUpdateCount = 0;
+	UpdateLobbyCompletionState.LobbyPostCompletedCount = 0;
 	UpdateLobbyCompletionState.MergedCompletionResult = true;
 
+	bool bHasMemberSettings = false;
+
+	// Look up the owner first so a local owner's member properties go out in the same post as the lobby properties
+	const PFEntityKey* OwnerPtr = nullptr;
+	HRESULT OwnerHr = PFLobbyGetOwner(LobbyHandle, &OwnerPtr);
+	const bool bLocalOwner = SUCCEEDED(OwnerHr) && OwnerPtr != nullptr && PlayFabIdentityInt->IsUserLocal(*OwnerPtr);
+
+	// Gather every property and check the service limits before anything is posted or the shadow changes,
+	// a rejected update must not leave earlier posts in flight without an operation to complete them
+	struct FPendingMemberUpdate
+	{
+		TSharedPtr<FPlayFabUser> User;
+		TMap<FString, FString> MemberProperties;
+	};
+	TArray<FPendingMemberUpdate> PendingMemberUpdates;
+	bool bWithinLimits = true;
+
 	// Update member properties for all party local users
 	const TArray<TSharedPtr<FPlayFabUser>>& PartyLocalUsers = PlayFabIdentityInt->GetAllPartyLocalUsers();
 	for (TSharedPtr<FPlayFabUser> User : PartyLocalUsers)
@@ -450,46 +703,21 @@ bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings&
 		{
 			if (FSessionSettings* UpdatedMemberSettings = (FSessionSettings*)SessionSettings.MemberSettings.Find(FUniqueNetIdPlayFab::Create(User->GetPlatformUserId())))
 			{
-				UTF8StringList MemberKeys, MemberValues;
+				bHasMemberSettings = true;
+				FPendingMemberUpdate& PendingMemberUpdate = PendingMemberUpdates.AddDefaulted_GetRef();
+				PendingMemberUpdate.User = User;
 
 				for (FSessionSettings::TIterator It = UpdatedMemberSettings->CreateIterator(); It; ++It)
 				{
 					const FOnlineSessionSetting& SettingValue = It.Value();
-					const FString SettingNameString = It.Key().ToString();
-					const FString SettingValueString = SettingValue.Data.ToString();
 					// Only upload values that are marked for service use
 					if (SettingValue.AdvertisementType >= EOnlineDataAdvertisementType::ViaOnlineService)
 					{
-						if (SettingValueString.IsEmpty())
-						{
-							UE_LOG_ONLINE(Warning, TEXT("UpdateLobby Member Property: %s: <Empty>."), *SettingNameString);
-							MemberKeys.Add(SettingNameString);
-							MemberValues.AddNull();
-						}
-						else
-						{
-							UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby Member Property: %s: %s."), *SettingNameString, *SettingValueString);
-							MemberKeys.Add(SettingNameString);
-							MemberValues.Add(SettingValueString);
-						}
+						PendingMemberUpdate.MemberProperties.Add(It.Key().ToString(), SettingValue.Data.ToString());
 					}
 				}
 
-				PFEntityKey EntityKey = User->GetEntityKey();
-
-				PFLobbyMemberDataUpdate MemberUpdateData{};
-				MemberUpdateData.memberPropertyCount = MemberKeys.GetCount();
-				MemberUpdateData.memberPropertyKeys = MemberKeys.GetData();
-				MemberUpdateData.memberPropertyValues = MemberValues.GetData();
-
-				UpdateLobbyCompletionState.LobbyPostUpdateCount++;
-				TUniquePtr<TPair<int, int>> LobbyPostPair = MakeUnique<TPair<int, int>>(OperationId, UpdateLobbyCompletionState.LobbyPostUpdateCount);
-				HRESULT Hr = PFLobbyPostUpdate(LobbyHandle, &EntityKey, nullptr, &MemberUpdateData, reinterpret_cast<void*>(LobbyPostPair.Release()));
-				if (FAILED(Hr))
-				{
-					UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::PFLobbyPostUpdate update member properties failed. Error code [0x%08x]"), Hr);
-					return false;
-				}
+				bWithinLimits &= ValidatePropertyLimits(TEXT("UpdateLobby"), 0, 0, PendingMemberUpdate.MemberProperties.Num());
 			}
 			else
 			{
@@ -503,48 +731,144 @@ bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings&
 		}
 	}
 
-	// Update lobby properties and search properties if we are the host
-	const PFEntityKey* OwnerPtr;
-	HRESULT Hr = PFLobbyGetOwner(LobbyHandle, &OwnerPtr);
-	if (FAILED(Hr))
+	TMap<FString, FString> LobbyProperties;
+	TMap<FString, FString> SearchProperties;
+	if (bLocalOwner)
 	{
-		UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::UpdateLobby failed to GetOwner: 0x%08x"), Hr);
-		// Member properties were updated
-		if (UpdateLobbyCompletionState.LobbyPostUpdateCount > 0)
+		GatherOwnerLobbyProperties(SessionSettings, LobbyProperties, SearchProperties);
+		bWithinLimits &= ValidatePropertyLimits(TEXT("UpdateLobby"), LobbyProperties.Num(), SearchProperties.Num(), 0);
+	}
+
+	if (!bWithinLimits)
+	{
+		return false;
+	}
+
+	// Without delta updates every call starts from an empty shadow, which uploads every property as before
+	FPostedLobbyProperties& PostedProperties = PostedLobbyProperties.FindOrAdd(LobbyHandle);
+	FLobbyUpdateDeltaStats DeltaStats;
+	UTF8StringList OwnerMemberKeys, OwnerMemberValues;
+
+	for (const FPendingMemberUpdate& PendingMemberUpdate : PendingMemberUpdates)
+	{
+		PFEntityKey EntityKey = PendingMemberUpdate.User->GetEntityKey();
+		TMap<FString, uint32>& PostedMemberProperties = PostedProperties.MemberProperties.FindOrAdd(FString(UTF8_TO_TCHAR(EntityKey.id)));
+
+		const bool bIsOwner = bLocalOwner && IsSameEntity(EntityKey, *OwnerPtr);
+		UTF8StringList UserMemberKeys, UserMemberValues;
+		UTF8StringList& MemberKeys = bIsOwner ? OwnerMemberKeys : UserMemberKeys;
+		UTF8StringList& MemberValues = bIsOwner ? OwnerMemberValues : UserMemberValues;
+		AppendPropertyDelta(TEXT("Member"), PendingMemberUpdate.MemberProperties, PostedMemberProperties, !bEnableDeltaLobbyUpdates, MemberKeys, MemberValues, DeltaStats);
+		if (MemberKeys.GetCount() == 0 || bIsOwner)
 		{
-			UpdateLobbyOperations.Add(OperationId, UpdateLobbyCompletionState);
-			return true;
+			continue;
 		}
-		return false;
+
+		PFLobbyMemberDataUpdate MemberUpdateData{};
+		MemberUpdateData.memberPropertyCount = MemberKeys.GetCount();
+		MemberUpdateData.memberPropertyKeys = MemberKeys.GetData();
+		MemberUpdateData.memberPropertyValues = MemberValues.GetData();
+
+		UpdateLobbyCompletionState.LobbyPostUpdateCount++;
+		HRESULT Hr = PFLobbyPostUpdate(LobbyHandle, &EntityKey, nullptr, &MemberUpdateData, MakeOperationContext(OperationId));
+		if (FAILED(Hr))
+		{
+			UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::PFLobbyPostUpdate update member properties failed. Error code [0x%08x]"), Hr);
+			PostedLobbyProperties.Remove(LobbyHandle);
+			return false;
+		}
+	}
+
+	// Update lobby properties and search properties if we are the host
+	if (FAILED(OwnerHr))
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::UpdateLobby failed to GetOwner: 0x%08x"), OwnerHr);
+		// Member properties were updated
+		return FinishUpdateLobby(SessionName, OperationId, UpdateLobbyCompletionState, DeltaStats, bHasMemberSettings);
 	}
 
 	if (OwnerPtr == nullptr)
 	{
 		UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::UpdateLobby found no owner"));
 		// Member properties were updated
-		if (UpdateLobbyCompletionState.LobbyPostUpdateCount > 0)
-		{
-			UpdateLobbyOperations.Add(OperationId, UpdateLobbyCompletionState);
-			return true;
-		}
-		return false;
+		return FinishUpdateLobby(SessionName, OperationId, UpdateLobbyCompletionState, DeltaStats, bHasMemberSettings);
 	}
 
-	if (!PlayFabIdentityInt->IsUserLocal(*OwnerPtr))
+	if (!bLocalOwner)
 	{
 		UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::UpdateLobby Owner of the lobby is not a local user!"));
+		// Another owner may change the lobby properties, so the next update as owner uploads all of them
+		PostedProperties.ResetOwnerProperties();
 		// Member properties were updated
-		if (UpdateLobbyCompletionState.LobbyPostUpdateCount > 0)
+		return FinishUpdateLobby(SessionName, OperationId, UpdateLobbyCompletionState, DeltaStats, bHasMemberSettings);
+	}
+
+	PFLobbyAccessPolicy AccessPolicy = PFLobbyAccessPolicy::Private;
+	if (SessionSettings.bShouldAdvertise)
+	{
+		if (SessionSettings.bAllowJoinViaPresenceFriendsOnly)
 		{
-			UpdateLobbyOperations.Add(OperationId, UpdateLobbyCompletionState);
-			return true;
+			AccessPolicy = PFLobbyAccessPolicy::Friends;
+		}
+		else
+		{
+			AccessPolicy = PFLobbyAccessPolicy::Public;
 		}
-		return false;
 	}
 
+	const bool bFullOwnerUpload = !bEnableDeltaLobbyUpdates || !PostedProperties.bOwnerPropertiesPosted;
 	UTF8StringList LobbyKeys, LobbyValues;
 	UTF8StringList SearchKeys, SearchValues;
+	AppendPropertyDelta(TEXT("Lobby"), LobbyProperties, PostedProperties.LobbyProperties, bFullOwnerUpload, LobbyKeys, LobbyValues, DeltaStats);
+	AppendPropertyDelta(TEXT("Search"), SearchProperties, PostedProperties.SearchProperties, bFullOwnerUpload, SearchKeys, SearchValues, DeltaStats);
+	const bool bAccessPolicyChanged = bFullOwnerUpload || PostedProperties.AccessPolicy != AccessPolicy;
+	PostedProperties.AccessPolicy = AccessPolicy;
+	PostedProperties.bOwnerPropertiesPosted = true;
+
+	const bool bHasLobbyChanges = LobbyKeys.GetCount() > 0 || SearchKeys.GetCount() > 0 || bAccessPolicyChanged;
+	if (!bHasLobbyChanges && OwnerMemberKeys.GetCount() == 0)
+	{
+		return FinishUpdateLobby(SessionName, OperationId, UpdateLobbyCompletionState, DeltaStats, true);
+	}
+
+	PFLobbyMemberDataUpdate OwnerMemberUpdateData{};
+	OwnerMemberUpdateData.memberPropertyCount = OwnerMemberKeys.GetCount();
+	OwnerMemberUpdateData.memberPropertyKeys = OwnerMemberKeys.GetData();
+	OwnerMemberUpdateData.memberPropertyValues = OwnerMemberValues.GetData();
+	if (bHasLobbyChanges && OwnerMemberKeys.GetCount() > 0)
+	{
+		LobbyUpdatePostsSaved++;
+	}
+
+	PFLobbyDataUpdate UpdateData = {};
+
+	UpdateData.lobbyPropertyCount = LobbyKeys.GetCount();
+	UpdateData.lobbyPropertyKeys = LobbyKeys.GetData();
+	UpdateData.lobbyPropertyValues = LobbyValues.GetData();
+
+	UpdateData.searchPropertyCount = SearchKeys.GetCount();
+	UpdateData.searchPropertyKeys = SearchKeys.GetData();
+	UpdateData.searchPropertyValues = SearchValues.GetData();
+
+	if (bAccessPolicyChanged)
+	{
+		UpdateData.accessPolicy = &AccessPolicy;
+	}
+
+	UpdateLobbyCompletionState.LobbyPostUpdateCount++;
+	HRESULT Hr = PFLobbyPostUpdate(LobbyHandle, OwnerPtr, bHasLobbyChanges ? &UpdateData : nullptr, OwnerMemberKeys.GetCount() > 0 ? &OwnerMemberUpdateData : nullptr, MakeOperationContext(OperationId));
+	if (FAILED(Hr))
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::PFLobbyPostUpdate update lobby and search properties failed. Error code [0x%08x]"), Hr);
+		PostedLobbyProperties.Remove(LobbyHandle);
+		return false;
+	}
+
+	return FinishUpdateLobby(SessionName, OperationId, UpdateLobbyCompletionState, DeltaStats, true);
+}
 
+void FPlayFabLobby::GatherOwnerLobbyProperties(const FOnlineSessionSettings& SessionSettings, TMap<FString, FString>& LobbyProperties, TMap<FString, FString>& SearchProperties)
+{
 	// Set session custom settings
 	for (FSessionSettings::TConstIterator It(SessionSettings.Settings); It; ++It)
 	{
@@ -556,60 +880,25 @@ bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings&
 		// Only upload values that are marked for service use
 		if (SettingValue.AdvertisementType >= EOnlineDataAdvertisementType::ViaOnlineService)
 		{
-			if (SettingValueString.IsEmpty())
-			{
-				UE_LOG_ONLINE(Warning, TEXT("UpdateLobby Lobby Property: %s: <Empty>."), *SettingNameString);
-				LobbyKeys.Add(SettingNameString);
-				LobbyValues.AddNull();
-			}
-			else
-			{
-				UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby Lobby Property: %s: %s."), *SettingNameString, *SettingValueString);
-				LobbyKeys.Add(SettingNameString);
-				LobbyValues.Add(SettingValueString);
-			}
+			LobbyProperties.Add(SettingNameString, SettingValueString);
 		}
 
 		// Add search attribute settings to lobby's search properties
 		if (IsSearchKey(SettingNameString))
 		{
-			if (SettingValueString.IsEmpty())
+			SearchProperties.Add(SettingNameString, SettingValueString);
+		}
+		else if (const FSettingSearchKey* SettingSearchKey = FindSearchKeyForSetting(SettingName))
+		{
+			FString SearchValue;
+			if (EncodeSearchPropertyValue(SettingValue.Data, SettingSearchKey->Type, SearchValue))
 			{
-				UE_LOG_ONLINE(Warning, TEXT("UpdateLobby Search Property: %s: <Empty>."), *SettingNameString);
-				SearchKeys.Add(SettingNameString);
-				SearchValues.AddNull();
+				UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby: predefined item %s(%s): %s Type: %d."), *SettingNameString, *SettingSearchKey->SearchKey, *SearchValue, SettingSearchKey->Type);
+				SearchProperties.Add(SettingSearchKey->SearchKey, SearchValue);
 			}
 			else
 			{
-				UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby Search Property: %s: %s."), *SettingNameString, *SettingValueString);
-				SearchKeys.Add(SettingNameString);
-				SearchValues.Add(SettingValueString);
-			}
-		}
-		else
-		{
-			FString SearchKey;
-			EOnlineKeyValuePairDataType::Type Type;
-			if (GetSearchKeyFromSettingMappingTable(SettingNameString, SearchKey, Type))
-			{
-				UE_LOG_ONLINE(Verbose, TEXT("UpdateLobby: predefined item %s(%s): %s Type: %d."), *SettingNameString, *SearchKey, *SettingValueString, Type);
-				switch (Type)
-				{
-				case EOnlineKeyValuePairDataType::Bool:
-				{
-					const FVariantData& VariantData = SettingValue.Data;
-					bool BoolVal;
-					VariantData.GetValue(BoolVal);
-					SearchKeys.Add(TCHAR_TO_UTF8(*SearchKey));
-					SearchValues.Add(BoolVal == true ? "1" : "0");
-					break;
-				}
-				case EOnlineKeyValuePairDataType::Int32:
-				case EOnlineKeyValuePairDataType::String:
-					SearchKeys.Add(TCHAR_TO_UTF8(*SearchKey));
-					SearchValues.Add(SettingValueString);
-					break;
-				}
+				UE_LOG_ONLINE(Warning, TEXT("UpdateLobby: %s value %s cannot be stored as %s, it is not searchable."), *SettingNameString, *SettingValueString, EOnlineKeyValuePairDataType::ToString(SettingSearchKey->Type));
 			}
 		}
 	}
@@ -633,44 +922,37 @@ bool FPlayFabLobby::UpdateLobby(FName SessionName, const FOnlineSessionSettings&
 		const FString SessionSettingsFlagsValue(FString::FromInt(SessionSettingsFlags));
 
 		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Applying session settings flags: %s: %s."), *SessionSettingsFlagsName, *SessionSettingsFlagsValue);
-		LobbyKeys.Add(SessionSettingsFlagsName);
-		LobbyValues.Add(SessionSettingsFlagsValue);
+		LobbyProperties.Add(SessionSettingsFlagsName, SessionSettingsFlagsValue);
 	}
+}
 
-	PFLobbyDataUpdate UpdateData = {};
+bool FPlayFabLobby::FinishUpdateLobby(FName SessionName, int OperationId, const FUpdateLobbyCompletionState& UpdateLobbyCompletionState, const FLobbyUpdateDeltaStats& DeltaStats, bool bSucceededWithoutPost)
+{
+	LobbyUpdateCount++;
+	LobbyUpdateKeysSent += DeltaStats.KeysSent;
+	LobbyUpdateKeysSkipped += DeltaStats.KeysSkipped;
+	LobbyUpdateBytesSent += DeltaStats.BytesSent;
+	LobbyUpdatePostCount += UpdateLobbyCompletionState.LobbyPostUpdateCount;
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::UpdateLobby: Session %s sent %u keys (%u deleted, %u bytes) in %d posts, skipped %u unchanged keys. Totals over %u updates: %llu keys sent, %llu skipped, %llu bytes, %u posts saved by batching"),
+		*SessionName.ToString(), DeltaStats.KeysSent, DeltaStats.KeysDeleted, DeltaStats.BytesSent, UpdateLobbyCompletionState.LobbyPostUpdateCount, DeltaStats.KeysSkipped,
+		LobbyUpdateCount, LobbyUpdateKeysSent, LobbyUpdateKeysSkipped, LobbyUpdateBytesSent, LobbyUpdatePostsSaved);
+
+	if (UpdateLobbyCompletionState.LobbyPostUpdateCount > 0)
+	{
+		UpdateLobbyOperations.Add(OperationId, UpdateLobbyCompletionState);
+		return true;
+	}
 
-	UpdateData.lobbyPropertyCount = LobbyKeys.GetCount();
-	UpdateData.lobbyPropertyKeys = LobbyKeys.GetData();
-	UpdateData.lobbyPropertyValues = LobbyValues.GetData();
+	if (!bSucceededWithoutPost)
+	{
+		return false;
+	}
 
-	UpdateData.searchPropertyCount = SearchKeys.GetCount();
-	UpdateData.searchPropertyKeys = SearchKeys.GetData();
-	UpdateData.searchPropertyValues = SearchValues.GetData();
-
-	PFLobbyAccessPolicy AccessPolicy = PFLobbyAccessPolicy::Private;
-	if (SessionSettings.bShouldAdvertise)
-	{
-		if (SessionSettings.bAllowJoinViaPresenceFriendsOnly)
-		{
-			AccessPolicy = PFLobbyAccessPolicy::Friends;
-		}
-		else
-		{
-			AccessPolicy = PFLobbyAccessPolicy::Public;
-		}
-	}
-	UpdateData.accessPolicy = &AccessPolicy;
-
-	UpdateLobbyCompletionState.LobbyPostUpdateCount++;
-	TUniquePtr<TPair<int, int>> LobbyPostPair = MakeUnique<TPair<int, int>>(OperationId, UpdateLobbyCompletionState.LobbyPostUpdateCount);
-	Hr = PFLobbyPostUpdate(LobbyHandle, OwnerPtr, &UpdateData, nullptr, reinterpret_cast<void*>(LobbyPostPair.Release()));
-	if (FAILED(Hr))
+	// Nothing changed since the last update, complete on the next tick as if the service had acknowledged it
+	OSSPlayFab->ExecuteNextTick([this, SessionName]()
 	{
-		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::PFLobbyPostUpdate update lobby and search properties failed. Error code [0x%08x]"), Hr);
-		return false;
-	}
-
-	UpdateLobbyOperations.Add(OperationId, UpdateLobbyCompletionState);
+		CompleteLobbyUpdate(SessionName, true);
+	});
 	return true;
 }
 
@@ -818,22 +1100,60 @@ bool FPlayFabLobby::FindLobbies(const FUniqueNetId& UserId, TSharedPtr<FOnlineSe
 	SearchingUserNum = PlayFabIdentityInt->GetPlatformUserIdFromUniqueNetId(UserId);
 	
 	PFLobbySearchConfiguration LobbySearchConfig{};
-	FString QueryFilter;
 
-	// Add lobby query filter string depending on search params specified in query settings
-	QueryFilter = ComposeLobbySearchQueryFilter(SearchSettings->QuerySettings.SearchParams);
-	std::string FilterString(TCHAR_TO_UTF8(*QueryFilter));
-	if (!QueryFilter.IsEmpty())
+	// Add lobby query filter string depending on search params specified in query settings,
+	// the parameters the service cannot evaluate are applied to the results when they arrive
+	const FCompiledLobbySearchFilter& SearchFilter = GetCompiledSearchFilter(SearchSettings->QuerySettings.SearchParams);
+	if (SearchFilter.FilterString.Num() > 1)
 	{
-		LobbySearchConfig.filterString = FilterString.c_str();
+		LobbySearchConfig.filterString = SearchFilter.FilterString.GetData();
 	}
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::FindLobbies: %d predicates pushed down \"%s\", %d filtered locally [%s], %d ignored"),
+		SearchFilter.PushedPredicateCount, UTF8_TO_TCHAR(SearchFilter.FilterString.GetData()), SearchFilter.LocalPredicates.Num(), *SearchFilter.LocalPredicatesDescription, SearchFilter.IgnoredPredicateCount);
 
 	PFEntityKey EntityKey = LocalUser->GetEntityKey();
 
-	HRESULT Hr = PFMultiplayerFindLobbies(OSSPlayFab->GetMultiplayerHandle(), &EntityKey, &LobbySearchConfig, nullptr);
+	FPendingLobbySearch PendingSearch;
+	PendingSearch.CacheKey = FString::Printf(TEXT("%s\x1e%s"), UTF8_TO_TCHAR(EntityKey.id), UTF8_TO_TCHAR(SearchFilter.FilterString.GetData()));
+	PendingSearch.StartTime = FPlatformTime::Seconds();
+	PendingSearch.LocalPredicates = SearchFilter.LocalPredicates;
+
+	if (LobbySearchCacheTTL > 0.0f)
+	{
+		FLobbySearchCacheEntry* CacheEntry = LobbySearchCache.Find(PendingSearch.CacheKey);
+		const double CacheAge = CacheEntry ? PendingSearch.StartTime - CacheEntry->FetchTime : 0.0;
+		if (CacheEntry && CacheAge <= LobbySearchCacheTTL + LobbySearchCacheStaleTime)
+		{
+			ServeLobbySearchFromCache(*CacheEntry, CacheAge, PendingSearch.LocalPredicates, SearchSettings);
+			if (CacheAge <= LobbySearchCacheTTL || CacheEntry->bRefreshing)
+			{
+				return true;
+			}
+
+			// Stale: the cached results have been served, refresh them in the background for the next search
+			CacheEntry->bRefreshing = true;
+			PendingSearch.bBackgroundRefresh = true;
+		}
+		else
+		{
+			LobbySearchCacheMisses++;
+		}
+	}
+
+	const int32 SearchId = NextLobbySearchId++;
+	PendingLobbySearches.Add(SearchId, PendingSearch);
+
+	HRESULT Hr = PFMultiplayerFindLobbies(OSSPlayFab->GetMultiplayerHandle(), &EntityKey, &LobbySearchConfig, MakeOperationContext(SearchId));
 	if (FAILED(Hr))
 	{
 		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::FindLobbies failed: Error code [0x%08x], Error message:%s"), Hr, *GetMultiplayerErrorMessage(Hr));
+		PendingLobbySearches.Remove(SearchId);
+		if (PendingSearch.bBackgroundRefresh)
+		{
+			// The caller already has the cached results
+			LobbySearchCache[PendingSearch.CacheKey].bRefreshing = false;
+			return true;
+		}
 		CurrentSessionSearch = nullptr;
 		SearchSettings->SearchState = EOnlineAsyncTaskState::Failed;
 		return false;
@@ -842,6 +1162,99 @@ bool FPlayFabLobby::FindLobbies(const FUniqueNetId& UserId, TSharedPtr<FOnlineSe
 	return true;
 }
 
+void FPlayFabLobby::ServeLobbySearchFromCache(const FLobbySearchCacheEntry& CacheEntry, double CacheAge, const TArray<FLocalSearchPredicate>& LocalPredicates, TSharedPtr<FOnlineSessionSearch> SearchSettings)
+{
+	// Entries are keyed by the pushed down filter, so the local predicates of this query still apply
+	for (const TPair<FString, FCachedLobbySearchResult>& CachedLobby : CacheEntry.Lobbies)
+	{
+		SearchSettings->SearchResults.Add(CachedLobby.Value.SearchResult);
+	}
+	ApplyLocalSearchPredicates(LocalPredicates, SearchSettings->SearchResults);
+	RankLobbySearchResults(SearchSettings->SearchResults);
+	SearchSettings->SearchState = EOnlineAsyncTaskState::Done;
+
+	if (CacheAge <= LobbySearchCacheTTL)
+	{
+		LobbySearchCacheHits++;
+	}
+	else
+	{
+		LobbySearchCacheStaleHits++;
+	}
+	LobbySearchCacheSecondsSaved += CacheEntry.FetchDuration;
+
+	const uint32 SearchCount = LobbySearchCacheHits + LobbySearchCacheStaleHits + LobbySearchCacheMisses;
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::FindLobbies: Served %d cached results (age %.1fs). Hit rate %.0f%% (%u fresh, %u stale, %u misses), %.3fs saved"),
+		SearchSettings->SearchResults.Num(), CacheAge, 100.0 * (LobbySearchCacheHits + LobbySearchCacheStaleHits) / SearchCount, LobbySearchCacheHits, LobbySearchCacheStaleHits, LobbySearchCacheMisses, LobbySearchCacheSecondsSaved);
+
+	// Complete on the next tick, as a search that went to the service would
+	const int32 LocalUserNum = SearchingUserNum;
+	OSSPlayFab->ExecuteNextTick([this, LocalUserNum, SearchSettings]()
+	{
+		TriggerOnFindLobbiesCompletedDelegates(LocalUserNum, true, SearchSettings);
+	});
+}
+
+uint32 FPlayFabLobby::ConvertLobbySearchResults(const PFLobbySearchResult* LobbySearchResults, uint32 LobbyCount, const TMap<FString, FCachedLobbySearchResult>* PreviousLobbies, TArray<FCachedLobbySearchResult>& OutLobbies, bool bAllowParallel)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	OutLobbies.SetNum(LobbyCount);
+	std::atomic<uint32> ReusedResults{ 0 };
+
+	// Each lobby is written to its own slot, so chunks can run in any order on any thread
+	auto ConvertLobby = [this, LobbySearchResults, PreviousLobbies, &OutLobbies, &ReusedResults](int32 LobbyIndex)
+	{
+		const PFLobbySearchResult& LobbySearchResult = LobbySearchResults[LobbyIndex];
+		FCachedLobbySearchResult& CachedLobby = OutLobbies[LobbyIndex];
+		if (PreviousLobbies)
+		{
+			// Only lobbies whose properties changed since the last search are converted again
+			CachedLobby.ContentHash = HashLobbySearchResult(LobbySearchResult);
+			const FCachedLobbySearchResult* PreviousLobby = PreviousLobbies->Find(UTF8_TO_TCHAR(LobbySearchResult.lobbyId));
+			if (PreviousLobby && PreviousLobby->ContentHash == CachedLobby.ContentHash)
+			{
+				CachedLobby.SearchResult = PreviousLobby->SearchResult;
+				ReusedResults++;
+				return;
+			}
+		}
+		CachedLobby.SearchResult = CreateSearchResultFromLobby(LobbySearchResult);
+	};
+
+	const int32 ChunkSize = FMath::Max(LobbySearchConversionChunkSize, 1);
+	const int32 ChunkCount = FMath::DivideAndRoundUp(static_cast<int32>(LobbyCount), ChunkSize);
+	const bool bParallel = bAllowParallel && bEnableParallelSearchConversion && ChunkCount > 1;
+	ParallelFor(ChunkCount, [ChunkSize, LobbyCount, &ConvertLobby](int32 ChunkIndex)
+	{
+		const int32 EndIndex = FMath::Min((ChunkIndex + 1) * ChunkSize, static_cast<int32>(LobbyCount));
+		for (int32 LobbyIndex = ChunkIndex * ChunkSize; LobbyIndex < EndIndex; ++LobbyIndex)
+		{
+			ConvertLobby(LobbyIndex);
+		}
+	}, !bParallel);
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::ConvertLobbySearchResults: Converted %u lobbies in %.3fms (%s, %d chunks), %u reused"),
+		LobbyCount, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles), bParallel ? TEXT("parallel") : TEXT("serial"), ChunkCount, ReusedResults.load());
+	return ReusedResults.load();
+}
+
+uint32 FPlayFabLobby::HashLobbySearchResult(const PFLobbySearchResult& LobbySearchResult)
+{
+	uint32 Hash = FCrc::StrCrc32(LobbySearchResult.connectionString ? LobbySearchResult.connectionString : "");
+	if (LobbySearchResult.ownerEntity != nullptr)
+	{
+		Hash = FCrc::StrCrc32(LobbySearchResult.ownerEntity->id, Hash);
+	}
+	Hash = FCrc::MemCrc32(&LobbySearchResult.maxMemberCount, sizeof(LobbySearchResult.maxMemberCount), Hash);
+	Hash = FCrc::MemCrc32(&LobbySearchResult.currentMemberCount, sizeof(LobbySearchResult.currentMemberCount), Hash);
+	for (uint32_t i = 0; i < LobbySearchResult.searchPropertyCount; i++)
+	{
+		Hash = FCrc::StrCrc32(LobbySearchResult.searchPropertyKeys[i], Hash);
+		Hash = FCrc::StrCrc32(LobbySearchResult.searchPropertyValues[i] ? LobbySearchResult.searchPropertyValues[i] : "", Hash);
+	}
+	return Hash;
+}
+
 bool FPlayFabLobby::FindFriendLobbies(const FUniqueNetId& UserId)
 {
 #ifndef OSS_PLAYFAB_GDK
@@ -941,9 +1354,17 @@ void FPlayFabLobby::DoWork()
 		return;
 	}
 
+	FPlayFabStateChangeTrace* Trace = OSSPlayFab->GetStateChangeTrace();
+	if (Trace && !Trace->IsRecording())
+	{
+		Trace = nullptr;
+	}
+	const uint64 BatchStartCycles = Trace ? FPlatformTime::Cycles64() : 0;
+
 	for (uint32 i = 0; i < StateChangeCount; ++i)
 	{
 		const PFLobbyStateChange& StateChange = *StateChanges[i];
+		const uint64 HandlerStartCycles = Trace ? FPlatformTime::Cycles64() : 0;
 
 		switch (StateChange.stateChangeType)
 		{
@@ -990,24 +1411,30 @@ void FPlayFabLobby::DoWork()
 			case PFLobbyStateChangeType::PostUpdateCompleted:
 			{
 				const auto& UpdateCompleted = static_cast<const PFLobbyPostUpdateCompletedStateChange&>(StateChange);
-				TUniquePtr<TPair<int, int>> LobbyPostPair(reinterpret_cast<TPair<int, int>*> (UpdateCompleted.asyncContext));
-				if (LobbyPostPair != nullptr)
+				if (UpdateCompleted.asyncContext != nullptr)
 				{
-					int UpdateLobbyOperationId = LobbyPostPair->Key;
+					int UpdateLobbyOperationId = GetOperationContextId(UpdateCompleted.asyncContext);
 					FUpdateLobbyCompletionState* UpdateLobbyCompletionState = UpdateLobbyOperations.Find(UpdateLobbyOperationId);
 					if (UpdateLobbyCompletionState == nullptr)
 					{
-						UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::DoWork received PFLobbyStateChangeType::PostUpdateCompleted, but UpdateLobbyOperations does not have valid key %d: "), LobbyPostPair->Key);
+						UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::DoWork received PFLobbyStateChangeType::PostUpdateCompleted, but UpdateLobbyOperations does not have valid key %d: "), UpdateLobbyOperationId);
 					}
 					else
 					{
-						UpdateLobbyOperations[UpdateLobbyOperationId].MergedCompletionResult = UpdateLobbyCompletionState->MergedCompletionResult && SUCCEEDED(UpdateCompleted.result);
+						if (FAILED(UpdateCompleted.result))
+						{
+							// The service state is unknown after a failed post, so the next update uploads everything again
+							PostedLobbyProperties.Remove(UpdateCompleted.lobby);
+						}
+						UpdateLobbyCompletionState->MergedCompletionResult = UpdateLobbyCompletionState->MergedCompletionResult && SUCCEEDED(UpdateCompleted.result);
+						UpdateLobbyCompletionState->LobbyPostCompletedCount++;
 						// All PFLobbyPostUpdate calls in one UpdateLobby have been received
-						if (UpdateLobbyCompletionState->LobbyPostUpdateCount == LobbyPostPair->Value)
+						if (UpdateLobbyCompletionState->LobbyPostCompletedCount == UpdateLobbyCompletionState->LobbyPostUpdateCount)
 						{
 							FName* SessionName = LobbySessionMap.Find(UpdateCompleted.lobby);
-							TriggerOnUpdateLobbyCompletedDelegates(*SessionName, UpdateLobbyOperations[UpdateLobbyOperationId].MergedCompletionResult);
+							const bool bMergedCompletionResult = UpdateLobbyCompletionState->MergedCompletionResult;
 							UpdateLobbyOperations.Remove(UpdateLobbyOperationId);
+							CompleteLobbyUpdate(*SessionName, bMergedCompletionResult);
 
 							// All UpdateLobby calls have been handled
 							if (UpdateLobbyOperations.Num() == 0)
@@ -1064,12 +1491,24 @@ void FPlayFabLobby::DoWork()
 				break;
 			}
 		}
+
+		if (Trace)
+		{
+			Trace->RecordStateChange(EPlayFabStateChangeSource::Lobby, static_cast<uint32>(StateChange.stateChangeType), FPlatformTime::Cycles64() - HandlerStartCycles);
+		}
 	}
 	Hr = PFMultiplayerFinishProcessingLobbyStateChanges(OSSPlayFab->GetMultiplayerHandle(), StateChangeCount, StateChanges);
 	if (FAILED(Hr))
 	{
 		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::DoWork::PFMultiplayerFinishProcessingLobbyStateChanges failed. ErrorCode=[0x%08x], Error message:%s"), Hr, *GetMultiplayerErrorMessage(Hr));
 	}
+
+	if (Trace)
+	{
+		Trace->RecordBatch(EPlayFabStateChangeSource::Lobby, StateChangeCount, FPlatformTime::Cycles64() - BatchStartCycles);
+	}
+
+	TickLobbyUpdateSchedules();
 }
 
 void FPlayFabLobby::HandleCreateAndJoinLobbyCompleted(const PFLobbyCreateAndJoinLobbyCompletedStateChange& StateChange)
@@ -1157,10 +1596,12 @@ void FPlayFabLobby::HandleJoinLobbyCompleted(const PFLobbyJoinLobbyCompletedStat
 	{
 		UE_LOG_ONLINE(Error, TEXT("Failed to join lobby. ErrorCode=[0x%08x]"), StateChange.result);
 		JoinResult = ConvertMultiplayerErrorToJoinSessionResult(StateChange.result);
+		OSSPlayFab->GetJoinTimeline()->Finish(false);
 	}
 	else
 	{
 		JoinResult = EOnJoinSessionCompleteResult::Success;
+		OSSPlayFab->GetJoinTimeline()->MarkPhase(EPlayFabJoinPhase::LobbyJoined);
 
 		const PFEntityKey* OwnerEntityKeyPtr;
 		HRESULT Hr = PFLobbyGetOwner(StateChange.lobby, &OwnerEntityKeyPtr);
@@ -1225,9 +1666,11 @@ void FPlayFabLobby::HandleJoinArrangedLobbyCompleted(const PFLobbyJoinArrangedLo
 	if (FAILED(StateChange.result))
 	{
 		UE_LOG_ONLINE(Error, TEXT("Failed to join arranged lobby. ErrorCode=[0x%08x]"), StateChange.result);
+		OSSPlayFab->GetJoinTimeline()->Finish(false);
 		TriggerOnJoinArrangedLobbyCompletedDelegates(*SessionName, false);
 		return;
 	}
+	OSSPlayFab->GetJoinTimeline()->MarkPhase(EPlayFabJoinPhase::LobbyJoined);
 
 	auto SessionInterface = OSSPlayFab->GetSessionInterfacePlayFab();
 	FNamedOnlineSessionPtr ExistingNamedSession = SessionInterface->GetNamedSessionPtr(*SessionName);
@@ -1306,6 +1749,14 @@ void FPlayFabLobby::HandleLobbyUpdate(const PFLobbyUpdatedStateChange& StateChan
 {
 	UE_LOG_ONLINE(Verbose, TEXT("Received PFLobbyUpdatedStateChange(%u) event"), StateChange.stateChangeType);
 
+	if (StateChange.ownerUpdated)
+	{
+		if (FPostedLobbyProperties* PostedProperties = PostedLobbyProperties.Find(StateChange.lobby))
+		{
+			PostedProperties->ResetOwnerProperties();
+		}
+	}
+
 	FName* SessionName = LobbySessionMap.Find(StateChange.lobby);
 	TriggerOnLobbyUpdateDelegates(*SessionName, StateChange);
 }
@@ -1388,7 +1839,9 @@ void FPlayFabLobby::HandleLeaveLobbyCompleted(const PFLobbyLeaveLobbyCompletedSt
 		if (ExistingNamedSession->SessionState == EOnlineSessionState::Destroying)
 		{
 			SessionInterface->RemoveNamedSession(*SessionName);
+			CancelLobbyUpdates(*SessionName);
 			LobbySessionMap.Remove(StateChange.lobby);
+			PostedLobbyProperties.Remove(StateChange.lobby);
 			TriggerOnLeaveLobbyCompletedDelegates(*SessionName, true);
 		}
 		else
@@ -1407,23 +1860,80 @@ void FPlayFabLobby::HandleFindLobbiesCompleted(const PFLobbyFindLobbiesCompleted
 {
 	UE_LOG_ONLINE(Verbose, TEXT("HandleFindLobbiesCompleted: result: 0x%08x"), StateChange.result);
 
+	// Friend searches carry no context and are never cached
+	FPendingLobbySearch PendingSearch;
+	const bool bTrackedSearch = StateChange.asyncContext != nullptr && PendingLobbySearches.RemoveAndCopyValue(GetOperationContextId(StateChange.asyncContext), PendingSearch);
+	FLobbySearchCacheEntry* CacheEntry = nullptr;
+	if (bTrackedSearch && LobbySearchCacheTTL > 0.0f)
+	{
+		CacheEntry = SUCCEEDED(StateChange.result) ? &LobbySearchCache.FindOrAdd(PendingSearch.CacheKey) : LobbySearchCache.Find(PendingSearch.CacheKey);
+	}
+	if (CacheEntry)
+	{
+		CacheEntry->bRefreshing = false;
+	}
+
 	if (FAILED(StateChange.result))
 	{
 		UE_LOG_ONLINE(Error, TEXT("Failed to find lobbies. ErrorCode=[0x%08x]"), StateChange.result);
+		if (PendingSearch.bBackgroundRefresh)
+		{
+			return;
+		}
 		CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::Failed;
 	}
 	else
 	{
+		TArray<FCachedLobbySearchResult> ConvertedLobbies;
+		const uint32 ReusedResults = ConvertLobbySearchResults(StateChange.searchResults, StateChange.searchResultCount, CacheEntry ? &CacheEntry->Lobbies : nullptr, ConvertedLobbies);
+
+		// Results are added in the order the service returned them, however the conversion was split
+		TMap<FString, FCachedLobbySearchResult> Lobbies;
 		for (uint32_t i = 0; i < StateChange.searchResultCount; i++)
 		{
+			const PFLobbySearchResult& LobbySearchResult = StateChange.searchResults[i];
+			FCachedLobbySearchResult& CachedLobby = ConvertedLobbies[i];
+
 			FString ConnectionString;
-			FOnlineSessionSearchResult SearchResult = CreateSearchResultFromLobby(StateChange.searchResults[i]);
-			if ((SearchResult.Session.SessionSettings.Get(SETTING_CONNECTION_STRING, ConnectionString)) == true && !ConnectionString.IsEmpty())
+			if ((CachedLobby.SearchResult.Session.SessionSettings.Get(SETTING_CONNECTION_STRING, ConnectionString)) == true && !ConnectionString.IsEmpty())
+			{
+				if (!PendingSearch.bBackgroundRefresh)
+				{
+					CurrentSessionSearch->SearchResults.Add(CachedLobby.SearchResult);
+				}
+				if (CacheEntry)
+				{
+					Lobbies.Add(UTF8_TO_TCHAR(LobbySearchResult.lobbyId), MoveTemp(CachedLobby));
+				}
+			}
+		}
+
+		if (CacheEntry)
+		{
+			const double Now = FPlatformTime::Seconds();
+			CacheEntry->Lobbies = MoveTemp(Lobbies);
+			CacheEntry->FetchTime = Now;
+			CacheEntry->FetchDuration = Now - PendingSearch.StartTime;
+			UE_LOG_ONLINE(Verbose, TEXT("HandleFindLobbiesCompleted: Cached %d lobbies in %.3fs, %u reused without conversion%s"),
+				CacheEntry->Lobbies.Num(), CacheEntry->FetchDuration, ReusedResults, PendingSearch.bBackgroundRefresh ? TEXT(" (background refresh)") : TEXT(""));
+
+			// Drop entries that can no longer be served
+			for (auto It = LobbySearchCache.CreateIterator(); It; ++It)
 			{
-				CurrentSessionSearch->SearchResults.Add(SearchResult);
+				if (!It.Value().bRefreshing && Now - It.Value().FetchTime > LobbySearchCacheTTL + LobbySearchCacheStaleTime)
+				{
+					It.RemoveCurrent();
+				}
 			}
 		}
 
+		if (PendingSearch.bBackgroundRefresh)
+		{
+			return;
+		}
+
+		ApplyLocalSearchPredicates(PendingSearch.LocalPredicates, CurrentSessionSearch->SearchResults);
+		RankLobbySearchResults(CurrentSessionSearch->SearchResults);
 		CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::Done;
 	}
 
@@ -1471,8 +1981,11 @@ void FPlayFabLobby::HandleLobbyDisconnected(const PFLobbyDisconnectedStateChange
 	FName* SessionName = LobbySessionMap.Find(StateChange.lobby);
 	if (SessionName != nullptr)
 	{
+		const FName DisconnectedSessionName = *SessionName;
 		LobbySessionMap.Remove(StateChange.lobby);
-		TriggerOnLobbyDisconnectedDelegates(*SessionName);
+		PostedLobbyProperties.Remove(StateChange.lobby);
+		CancelLobbyUpdates(DisconnectedSessionName);
+		TriggerOnLobbyDisconnectedDelegates(DisconnectedSessionName);
 	}
 	else
 	{
@@ -1520,6 +2033,42 @@ bool FPlayFabLobby::GetLobbyFromSession(const FName SessionName, PFLobbyHandle&
 	return false;
 }
 
+bool FPlayFabLobby::ValidatePropertyLimits(const TCHAR* Operation, uint32 LobbyPropertyCount, uint32 SearchPropertyCount, uint32 MemberPropertyCount) const
+{
+	bool bWithinLimits = true;
+
+	if (LobbyPropertyCount > PFLobbyMaxLobbyPropertyCount)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::%s: %u lobby properties exceed the service limit of %u"), Operation, LobbyPropertyCount, PFLobbyMaxLobbyPropertyCount);
+		bWithinLimits = false;
+	}
+
+	if (SearchPropertyCount > PFLobbyMaxSearchPropertyCount)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::%s: %u search properties exceed the service limit of %u"), Operation, SearchPropertyCount, PFLobbyMaxSearchPropertyCount);
+		bWithinLimits = false;
+	}
+
+	if (MemberPropertyCount > PFLobbyMaxMemberPropertyCount)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::%s: %u member properties exceed the service limit of %u"), Operation, MemberPropertyCount, PFLobbyMaxMemberPropertyCount);
+		bWithinLimits = false;
+	}
+
+	return bWithinLimits;
+}
+
+bool FPlayFabLobby::ValidateMaxMemberCount(const TCHAR* Operation, uint32 MaxMemberCount) const
+{
+	if (MaxMemberCount < PFLobbyMaxMemberCountLowerLimit || MaxMemberCount > PFLobbyMaxMemberCountUpperLimit)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::%s: max member count %u is outside the service range [%u, %u]"), Operation, MaxMemberCount, PFLobbyMaxMemberCountLowerLimit, PFLobbyMaxMemberCountUpperLimit);
+		return false;
+	}
+
+	return true;
+}
+
 bool FPlayFabLobby::ValidateSessionForInvite(const FName SessionName)
 {
 	auto SessionInterface = OSSPlayFab->GetSessionInterfacePlayFab();
@@ -1577,56 +2126,40 @@ FOnlineSessionSearchResult FPlayFabLobby::CreateSearchResultFromLobby(const PFLo
 #endif
 	for (uint32_t i = 0; i < LobbySearchResult.searchPropertyCount; i++)
 	{
-		const FString SearchPropertyKey(UTF8_TO_TCHAR(LobbySearchResult.searchPropertyKeys[i]));
-		const FString SearchPropertyValue(UTF8_TO_TCHAR(LobbySearchResult.searchPropertyValues[i]));
-		if (SearchPropertyKey.Equals(SEARCH_KEY_PLATFORM_ID))
+		const char* SearchPropertyKey = LobbySearchResult.searchPropertyKeys[i];
+		const char* SearchPropertyValue = LobbySearchResult.searchPropertyValues[i] ? LobbySearchResult.searchPropertyValues[i] : "";
+
+		const FSearchKeyDecoder* Decoder = FindSearchKeyDecoder(SearchPropertyKey);
+		if (Decoder == nullptr)
 		{
-			NewSearchResult.Session.OwningUserId = FUniqueNetIdPlayFab::Create(SearchPropertyValue);
-			PlatformIdKeyFound = true;
+			NewSearchResult.Session.SessionSettings.Set(FName(UTF8_TO_TCHAR(SearchPropertyKey)), FString(UTF8_TO_TCHAR(SearchPropertyValue)), EOnlineDataAdvertisementType::ViaOnlineService);
 			continue;
 		}
 
-		if (SearchPropertyKey.Equals(SEARCH_KEY_HOST_NICKNAME))
+		switch (Decoder->Role)
 		{
-			NewSearchResult.Session.OwningUserName = SearchPropertyValue;
-			OwnerNicknameFound = true;
-			continue;
-		}
+			case ESearchKeyRole::PlatformId:
+				NewSearchResult.Session.OwningUserId = FUniqueNetIdPlayFab::Create(FString(UTF8_TO_TCHAR(SearchPropertyValue)));
+				PlatformIdKeyFound = true;
+				break;
+			case ESearchKeyRole::HostNickname:
+				NewSearchResult.Session.OwningUserName = UTF8_TO_TCHAR(SearchPropertyValue);
+				OwnerNicknameFound = true;
+				break;
 #if defined(USES_NATIVE_SESSION)
-		if (SearchPropertyKey.Equals(SEARCH_KEY_NATIVE_SESSIONID))
-		{
-			NewSessionInfo->SetNativeSessionIdString(SearchPropertyValue);
-			NativeSessionIdFound = true;
-			continue;
-		}
-		if (SearchPropertyKey.Equals(SEARCH_KEY_NATIVE_PLATFORM))
-		{
-			NewSessionInfo->SetNativePlatform(SearchPropertyValue);
-			NativePlatformFound = true;
-			continue;
-		}
+			case ESearchKeyRole::NativeSessionId:
+				NewSessionInfo->SetNativeSessionIdString(UTF8_TO_TCHAR(SearchPropertyValue));
+				NativeSessionIdFound = true;
+				break;
+			case ESearchKeyRole::NativePlatform:
+				NewSessionInfo->SetNativePlatform(UTF8_TO_TCHAR(SearchPropertyValue));
+				NativePlatformFound = true;
+				break;
 #endif
-
-		// return search properties back to session settings
-		auto SettingKey = SearchKeyMappingTable.Find(SearchPropertyKey);
-		if (SettingKey)
-		{
-			switch (SettingKey->Value)
-			{
-				case EOnlineKeyValuePairDataType::Bool:
-					NewSearchResult.Session.SessionSettings.Set(FName(SettingKey->Key), LobbySearchResult.searchPropertyValues[i][0] == '1' ? true : false, EOnlineDataAdvertisementType::ViaOnlineService);
-					break;
-				case EOnlineKeyValuePairDataType::Int32:
-					NewSearchResult.Session.SessionSettings.Set(FName(SettingKey->Key), FCString::Atoi(*SearchPropertyValue), EOnlineDataAdvertisementType::ViaOnlineService);
-					break;
-				case EOnlineKeyValuePairDataType::String:
-					NewSearchResult.Session.SessionSettings.Set(FName(SettingKey->Key), SearchPropertyValue, EOnlineDataAdvertisementType::ViaOnlineService);
-					break;
-			}
-		}
-		else
-		{
-			NewSearchResult.Session.SessionSettings.Set(FName(SearchPropertyKey), SearchPropertyValue, EOnlineDataAdvertisementType::ViaOnlineService);
+			default:
+				// return search properties back to session settings, decoding numbers straight from the UTF-8 value
+				SetSessionSettingFromSearchProperty(NewSearchResult.Session.SessionSettings, Decoder->SettingName, Decoder->Type, SearchPropertyValue);
+				break;
 		}
 	}
 
@@ -1662,111 +2195,520 @@ bool FPlayFabLobby::IsSearchKey(const FString& Name)
 	return Name.Equals(PFLobbyMemberCountSearchKey) || Name.Equals(PFLobbyAmMemberSearchKey) || Name.StartsWith(SEARCH_KEY_PREFIX_STRING) || Name.StartsWith(SEARCH_KEY_PREFIX_NUMBER);
 }
 
-FString FPlayFabLobby::ComposeLobbySearchQueryFilter(const FSearchParams& SearchParams)
+// Numeric search parameters and decoded settings. Unmapped search keys decode to strings, so numeric strings are read as numbers.
+static bool GetSearchValueAsNumber(const FVariantData& Value, double& OutNumber)
+{
+	switch (Value.GetType())
+	{
+		case EOnlineKeyValuePairDataType::Bool:
+		{
+			bool BoolValue;
+			Value.GetValue(BoolValue);
+			OutNumber = BoolValue ? 1.0 : 0.0;
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::Int32:
+		{
+			int32 Int32Value;
+			Value.GetValue(Int32Value);
+			OutNumber = Int32Value;
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::UInt32:
+		{
+			uint32 UInt32Value;
+			Value.GetValue(UInt32Value);
+			OutNumber = UInt32Value;
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::Int64:
+		{
+			int64 Int64Value;
+			Value.GetValue(Int64Value);
+			OutNumber = static_cast<double>(Int64Value);
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::UInt64:
+		{
+			uint64 UInt64Value;
+			Value.GetValue(UInt64Value);
+			OutNumber = static_cast<double>(UInt64Value);
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::Float:
+		{
+			float FloatValue;
+			Value.GetValue(FloatValue);
+			OutNumber = FloatValue;
+			return true;
+		}
+		case EOnlineKeyValuePairDataType::Double:
+			Value.GetValue(OutNumber);
+			return true;
+		case EOnlineKeyValuePairDataType::String:
+		{
+			FString StringValue;
+			Value.GetValue(StringValue);
+			if (!StringValue.IsNumeric())
+			{
+				return false;
+			}
+			OutNumber = FCString::Atod(*StringValue);
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+const FPlayFabLobby::FCompiledLobbySearchFilter& FPlayFabLobby::GetCompiledSearchFilter(const FSearchParams& SearchParams)
+{
+	// Key the cache on everything that affects the filter, in the order the filter is composed
+	FString CacheKey;
+	for (const TPair<FName, FOnlineSessionSearchParam>& SearchParam : SearchParams)
+	{
+		CacheKey += FString::Printf(TEXT("%s\x1f%d\x1f%d\x1f%s\x1e"), *SearchParam.Key.ToString(), static_cast<int32>(SearchParam.Value.ComparisonOp), static_cast<int32>(SearchParam.Value.Data.GetType()), *SearchParam.Value.Data.ToString());
+	}
+
+	if (const FCompiledLobbySearchFilter* CachedFilter = SearchFilterCache.Find(CacheKey))
+	{
+		SearchFilterCacheHitCount++;
+		UE_LOG_ONLINE(VeryVerbose, TEXT("FPlayFabLobby::GetCompiledSearchFilter: Cache hit (%u hits, %u compiles)"), SearchFilterCacheHitCount, SearchFilterCompileCount);
+		return *CachedFilter;
+	}
+
+	if (SearchFilterCache.Num() >= SearchFilterCacheMaxEntries)
+	{
+		SearchFilterCache.Reset();
+	}
+
+	FCompiledLobbySearchFilter& CompiledFilter = SearchFilterCache.Add(CacheKey);
+	PlanLobbySearchQuery(SearchParams, CompiledFilter);
+	SearchFilterCompileCount++;
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::GetCompiledSearchFilter: Compiled filter \"%s\" (%u hits, %u compiles)"), UTF8_TO_TCHAR(CompiledFilter.FilterString.GetData()), SearchFilterCacheHitCount, SearchFilterCompileCount);
+
+	return CompiledFilter;
+}
+
+void FPlayFabLobby::PlanLobbySearchQuery(const FSearchParams& SearchParams, FCompiledLobbySearchFilter& OutPlan)
 {
 	FString QueryFilter;
-	for (auto SearchParam : SearchParams)
+	int32 QueryFilterLength = 0;
+	for (const TPair<FName, FOnlineSessionSearchParam>& SearchParam : SearchParams)
 	{
-		const FString& SettingName = SearchParam.Key.ToString();
+		const FString SettingName = SearchParam.Key.ToString();
 		const FVariantData& SettingValue = SearchParam.Value.Data;
 		if (SettingValue.ToString().IsEmpty() || SettingName == SEARCH_PRESENCE.ToString() || SettingName == SEARCH_LOBBIES.ToString())
 		{
 			continue;
 		}
 
-		if (!QueryFilter.IsEmpty())
+		// The search key the setting is stored in. Search results decode it back to the setting, where local predicates read it
+		FString SearchKey;
+		EOnlineKeyValuePairDataType::Type Type;
+		FName DecodedSettingName = SearchParam.Key;
+		if (const FSettingSearchKey* SettingSearchKey = FindSearchKeyForSetting(SearchParam.Key))
 		{
-			QueryFilter.Append(TEXT(" and "));
+			SearchKey = SettingSearchKey->SearchKey;
+			Type = SettingSearchKey->Type;
 		}
-
-		EOnlineComparisonOp::Type ComparisonOp = SearchParam.Value.ComparisonOp;
-		FString ComparisonString;
-		switch (ComparisonOp)
+		else if (IsSearchKey(SettingName))
 		{
-			case EOnlineComparisonOp::Equals:
+			SearchKey = SettingName;
+			Type = SettingValue.IsNumeric() ? EOnlineKeyValuePairDataType::Double : EOnlineKeyValuePairDataType::String;
+			// A raw key that is mapped comes back under its mapped setting name
+			if (const FSearchKeyDecoder* Decoder = FindSearchKeyDecoder(TCHAR_TO_UTF8(*SearchKey)))
 			{
-				ComparisonString = TEXT("eq");
-				break;
+				DecodedSettingName = Decoder->SettingName;
 			}
+		}
+		else
+		{
+			UE_LOG_ONLINE(Error, TEXT("PlanLobbySearchQuery: Unhandled search parameter. Map %s to a search key with SearchKeyMappings in the OnlineSubsystemPlayFab config section to filter the lobby searching"), *SettingName);
+			OutPlan.IgnoredPredicateCount++;
+			continue;
+		}
+		const bool bNumeric = Type != EOnlineKeyValuePairDataType::String;
 
-			case EOnlineComparisonOp::NotEquals:
+		// In and NotIn take a comma separated list of values
+		const EOnlineComparisonOp::Type ComparisonOp = SearchParam.Value.ComparisonOp;
+		TArray<FString> Values;
+		bool bValuesEncoded = true;
+		if (ComparisonOp == EOnlineComparisonOp::In || ComparisonOp == EOnlineComparisonOp::NotIn)
+		{
+			TArray<FString> ListValues;
+			SettingValue.ToString().ParseIntoArray(ListValues, TEXT(","), true);
+			for (const FString& ListValue : ListValues)
 			{
-				ComparisonString = TEXT("ne");
-				break;
+				bValuesEncoded &= EncodeSearchPropertyValue(FVariantData(ListValue.TrimStartAndEnd()), Type, Values.AddDefaulted_GetRef());
 			}
+		}
+		else
+		{
+			bValuesEncoded = EncodeSearchPropertyValue(SettingValue, Type, Values.AddDefaulted_GetRef());
+		}
+		if (!bValuesEncoded || Values.Num() == 0)
+		{
+			UE_LOG_ONLINE(Error, TEXT("PlanLobbySearchQuery: %s value %s cannot be compared as %s, the parameter is ignored"), *SettingName, *SettingValue.ToString(), EOnlineKeyValuePairDataType::ToString(Type));
+			OutPlan.IgnoredPredicateCount++;
+			continue;
+		}
 
-			case EOnlineComparisonOp::GreaterThanEquals:
+		auto FormatPredicate = [&SearchKey, bNumeric](const TCHAR* ComparisonString, const FString& Value)
+		{
+			return bNumeric ? FString::Printf(TEXT("%s %s %s"), *SearchKey, ComparisonString, *Value) : FString::Printf(TEXT("%s %s '%s'"), *SearchKey, ComparisonString, *Value);
+		};
+
+		// The service filter supports eq, ne, gt, ge, lt and le joined by and. Near, and In with more than one value, are filtered locally.
+		FString Predicate;
+		switch (ComparisonOp)
+		{
+			case EOnlineComparisonOp::Equals:				Predicate = FormatPredicate(TEXT("eq"), Values[0]); break;
+			case EOnlineComparisonOp::NotEquals:			Predicate = FormatPredicate(TEXT("ne"), Values[0]); break;
+			case EOnlineComparisonOp::GreaterThanEquals:	Predicate = FormatPredicate(TEXT("ge"), Values[0]); break;
+			case EOnlineComparisonOp::GreaterThan:			Predicate = FormatPredicate(TEXT("gt"), Values[0]); break;
+			case EOnlineComparisonOp::LessThanEquals:		Predicate = FormatPredicate(TEXT("le"), Values[0]); break;
+			case EOnlineComparisonOp::LessThan:				Predicate = FormatPredicate(TEXT("lt"), Values[0]); break;
+			case EOnlineComparisonOp::In:
 			{
-				ComparisonString = TEXT("ge");
+				if (Values.Num() == 1)
+				{
+					Predicate = FormatPredicate(TEXT("eq"), Values[0]);
+				}
 				break;
 			}
-
-			case EOnlineComparisonOp::GreaterThan:
+			case EOnlineComparisonOp::NotIn:
 			{
-				ComparisonString = TEXT("gt");
+				for (const FString& Value : Values)
+				{
+					Predicate += Predicate.IsEmpty() ? FormatPredicate(TEXT("ne"), Value) : TEXT(" and ") + FormatPredicate(TEXT("ne"), Value);
+				}
 				break;
 			}
+			default:
+				break;
+		}
 
-			case EOnlineComparisonOp::LessThanEquals:
+		if (!Predicate.IsEmpty())
+		{
+			const int32 PredicateLength = FTCHARToUTF8(*Predicate).Length() + (QueryFilter.IsEmpty() ? 0 : 5);
+			if (QueryFilterLength + PredicateLength <= MaxLobbySearchFilterLength)
 			{
-				ComparisonString = TEXT("le");
-				break;
+				UE_LOG_ONLINE(Verbose, TEXT("PlanLobbySearchQuery: %s pushed down as %s"), *SettingName, *Predicate);
+				QueryFilter += QueryFilter.IsEmpty() ? Predicate : TEXT(" and ") + Predicate;
+				QueryFilterLength += PredicateLength;
+				OutPlan.PushedPredicateCount++;
+				continue;
 			}
+			UE_LOG_ONLINE(Warning, TEXT("PlanLobbySearchQuery: %s does not fit in the %d character service filter, it is filtered locally"), *Predicate, MaxLobbySearchFilterLength);
+		}
 
-			case EOnlineComparisonOp::LessThan:
+		FLocalSearchPredicate& LocalPredicate = OutPlan.LocalPredicates.AddDefaulted_GetRef();
+		LocalPredicate.SettingName = DecodedSettingName;
+		LocalPredicate.ComparisonOp = ComparisonOp;
+		LocalPredicate.bNumeric = bNumeric;
+		for (const FString& Value : Values)
+		{
+			if (bNumeric)
 			{
-				ComparisonString = TEXT("lt");
-				break;
+				LocalPredicate.NumberValues.Add(FCString::Atod(*Value));
 			}
-
-			default:
+			else
 			{
-				ComparisonString = TEXT("eq");
-				UE_LOG_ONLINE(Warning, TEXT("Comparison Operation %s not supported in PlayFab lobby queries. Defaulting to EQ"), EOnlineComparisonOp::ToString(ComparisonOp));
-				break;
+				LocalPredicate.StringValues.Add(Value);
 			}
 		}
 
-		FString SearchKey;
-		EOnlineKeyValuePairDataType::Type Type;
-		if (GetSearchKeyFromSettingMappingTable(SettingName, SearchKey, Type))
+		const FString LocalPredicateDescription = FString::Printf(TEXT("%s %s (%s)"), *SettingName, EOnlineComparisonOp::ToString(ComparisonOp), *FString::Join(Values, TEXT(",")));
+		UE_LOG_ONLINE(Verbose, TEXT("PlanLobbySearchQuery: %s filtered locally"), *LocalPredicateDescription);
+		OutPlan.LocalPredicatesDescription += OutPlan.LocalPredicatesDescription.IsEmpty() ? LocalPredicateDescription : TEXT(", ") + LocalPredicateDescription;
+	}
+
+	FTCHARToUTF8 Converter(*QueryFilter);
+	OutPlan.FilterString.Append(reinterpret_cast<const ANSICHAR*>(Converter.Get()), Converter.Length());
+	OutPlan.FilterString.Add('\0');
+}
+
+void FPlayFabLobby::ApplyLocalSearchPredicates(const TArray<FLocalSearchPredicate>& LocalPredicates, TArray<FOnlineSessionSearchResult>& SearchResults) const
+{
+	const int32 ResultCount = SearchResults.Num();
+	if (LocalPredicates.Num() == 0 || ResultCount == 0)
+	{
+		return;
+	}
+
+	// Each predicate gathers its setting into a column, then runs a branch-free pass over it into the keep mask.
+	// Results without the setting fail every comparison except NotEquals and NotIn. Strings compare case sensitively, in ordinal order.
+	TArray<uint8> Keep;
+	Keep.Init(1, ResultCount);
+	TArray<uint8> Present;
+	Present.SetNumUninitialized(ResultCount);
+	TArray<double> Column;
+	Column.SetNumUninitialized(ResultCount);
+	TArray<double> NearDistance;
+
+	for (const FLocalSearchPredicate& Predicate : LocalPredicates)
+	{
+		if (!Predicate.bNumeric)
 		{
-			UE_LOG_ONLINE(Verbose, TEXT("ComposeLobbySearchQueryFilter: predefined item %s(%s): %s Type: %d."), *SettingName, *SearchKey, *SettingValue.ToString(), Type);
-			switch (Type)
+			// Near has no distance between strings, so it neither filters nor orders string settings
+			if (Predicate.ComparisonOp == EOnlineComparisonOp::Near)
+			{
+				continue;
+			}
+
+			for (int32 ResultIndex = 0; ResultIndex < ResultCount; ++ResultIndex)
 			{
-			case EOnlineKeyValuePairDataType::Int32:
-				QueryFilter.Append(FString::Printf(TEXT("%s %s %s"), *SearchKey, *ComparisonString, *SettingValue.ToString()));
+				const FOnlineSessionSetting* Setting = SearchResults[ResultIndex].Session.SessionSettings.Settings.Find(Predicate.SettingName);
+				const FString Value = Setting ? Setting->Data.ToString() : FString();
+				bool bKept = false;
+				switch (Predicate.ComparisonOp)
+				{
+					case EOnlineComparisonOp::GreaterThanEquals:
+						bKept = Setting && Value.Compare(Predicate.StringValues[0], ESearchCase::CaseSensitive) >= 0;
+						break;
+					case EOnlineComparisonOp::GreaterThan:
+						bKept = Setting && Value.Compare(Predicate.StringValues[0], ESearchCase::CaseSensitive) > 0;
+						break;
+					case EOnlineComparisonOp::LessThanEquals:
+						bKept = Setting && Value.Compare(Predicate.StringValues[0], ESearchCase::CaseSensitive) <= 0;
+						break;
+					case EOnlineComparisonOp::LessThan:
+						bKept = Setting && Value.Compare(Predicate.StringValues[0], ESearchCase::CaseSensitive) < 0;
+						break;
+					default:
+					{
+						bool bMatched = false;
+						for (const FString& PredicateValue : Predicate.StringValues)
+						{
+							bMatched |= Setting && Value.Equals(PredicateValue, ESearchCase::CaseSensitive);
+						}
+						const bool bNegated = Predicate.ComparisonOp == EOnlineComparisonOp::NotEquals || Predicate.ComparisonOp == EOnlineComparisonOp::NotIn;
+						bKept = bNegated ? !bMatched : bMatched;
+						break;
+					}
+				}
+				Keep[ResultIndex] &= bKept ? 1 : 0;
+			}
+			continue;
+		}
+
+		for (int32 ResultIndex = 0; ResultIndex < ResultCount; ++ResultIndex)
+		{
+			const FOnlineSessionSetting* Setting = SearchResults[ResultIndex].Session.SessionSettings.Settings.Find(Predicate.SettingName);
+			double Number = 0.0;
+			Present[ResultIndex] = Setting && GetSearchValueAsNumber(Setting->Data, Number) ? 1 : 0;
+			Column[ResultIndex] = Number;
+		}
+
+		const double* Values = Column.GetData();
+		const uint8* HasValue = Present.GetData();
+		uint8* Kept = Keep.GetData();
+		const double Target = Predicate.NumberValues[0];
+		switch (Predicate.ComparisonOp)
+		{
+			case EOnlineComparisonOp::Equals:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & (Values[i] == Target); }
+				break;
+			case EOnlineComparisonOp::NotEquals:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= (HasValue[i] ^ 1) | (Values[i] != Target); }
+				break;
+			case EOnlineComparisonOp::GreaterThanEquals:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & (Values[i] >= Target); }
 				break;
-			case EOnlineKeyValuePairDataType::Bool:
+			case EOnlineComparisonOp::GreaterThan:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & (Values[i] > Target); }
+				break;
+			case EOnlineComparisonOp::LessThanEquals:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & (Values[i] <= Target); }
+				break;
+			case EOnlineComparisonOp::LessThan:
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & (Values[i] < Target); }
+				break;
+			case EOnlineComparisonOp::In:
 			{
-				bool BoolVal;
-				SettingValue.GetValue(BoolVal);
-				QueryFilter.Append(FString::Printf(TEXT("%s %s %d"), *SearchKey, *ComparisonString, static_cast<int32>(BoolVal)));
+				TArray<uint8> Matched;
+				Matched.SetNumZeroed(ResultCount);
+				for (double PredicateValue : Predicate.NumberValues)
+				{
+					for (int32 i = 0; i < ResultCount; ++i) { Matched[i] |= Values[i] == PredicateValue; }
+				}
+				for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= HasValue[i] & Matched[i]; }
 				break;
 			}
-			case EOnlineKeyValuePairDataType::String:
-				QueryFilter.Append(FString::Printf(TEXT("%s %s '%s'"), *SearchKey, *ComparisonString, *SettingValue.ToString()));
+			case EOnlineComparisonOp::NotIn:
+				for (double PredicateValue : Predicate.NumberValues)
+				{
+					for (int32 i = 0; i < ResultCount; ++i) { Kept[i] &= (HasValue[i] ^ 1) | (Values[i] != PredicateValue); }
+				}
+				break;
+			case EOnlineComparisonOp::Near:
+			{
+				// Near orders the results by distance instead of filtering them, the first Near parameter wins
+				if (NearDistance.Num() == 0)
+				{
+					NearDistance.SetNumUninitialized(ResultCount);
+					for (int32 i = 0; i < ResultCount; ++i) { NearDistance[i] = HasValue[i] ? FMath::Abs(Values[i] - Target) : TNumericLimits<double>::Max(); }
+				}
 				break;
 			}
+			default:
+				break;
 		}
-		else if (IsSearchKey(SettingName))
+	}
+
+	TArray<FOnlineSessionSearchResult> KeptResults;
+	TArray<double> KeptDistance;
+	KeptResults.Reserve(ResultCount);
+	for (int32 ResultIndex = 0; ResultIndex < ResultCount; ++ResultIndex)
+	{
+		if (Keep[ResultIndex])
 		{
-			if (SettingValue.IsNumeric())
-			{
-				QueryFilter.Append(FString::Printf(TEXT("%s %s %s"), *SettingName, *ComparisonString, *SettingValue.ToString()));
-			}
-			else
+			KeptResults.Add(MoveTemp(SearchResults[ResultIndex]));
+			if (NearDistance.Num() > 0)
 			{
-				QueryFilter.Append(FString::Printf(TEXT("%s %s '%s'"), *SettingName, *ComparisonString, *SettingValue.ToString()));
+				KeptDistance.Add(NearDistance[ResultIndex]);
 			}
 		}
-		else
+	}
+
+	if (KeptDistance.Num() > 0)
+	{
+		TArray<int32> Order;
+		Order.SetNumUninitialized(KeptResults.Num());
+		for (int32 i = 0; i < Order.Num(); ++i)
+		{
+			Order[i] = i;
+		}
+		Algo::StableSortBy(Order, [&KeptDistance](int32 ResultIndex) { return KeptDistance[ResultIndex]; });
+
+		SearchResults.Reset(KeptResults.Num());
+		for (int32 ResultIndex : Order)
 		{
-			UE_LOG_ONLINE(Error, TEXT("ComposeLobbySearchQueryFilter: Unhandled search parameter. Add %s to the s_SearchKeyMappingTable to filter the lobby searching"), *SettingName);
+			SearchResults.Add(MoveTemp(KeptResults[ResultIndex]));
 		}
 	}
+	else
+	{
+		SearchResults = MoveTemp(KeptResults);
+	}
 
-	return QueryFilter;
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::ApplyLocalSearchPredicates: %d local predicates kept %d of %d results"), LocalPredicates.Num(), SearchResults.Num(), ResultCount);
+}
+
+bool FPlayFabLobby::GetHostRegion(FString& OutRegion) const
+{
+	// Party creates the host's network in the closest of the regions it measured
+	TMap<FString, uint32> RegionRoundTripMs;
+	if (!OSSPlayFab->GetRegionRoundTripTimes(RegionRoundTripMs))
+	{
+		UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::GetHostRegion: No region latencies measured yet, the lobby is published without a host region"));
+		return false;
+	}
+
+	uint32 ClosestRoundTripMs = MAX_uint32;
+	for (const TPair<FString, uint32>& Region : RegionRoundTripMs)
+	{
+		if (Region.Value < ClosestRoundTripMs)
+		{
+			OutRegion = Region.Key;
+			ClosestRoundTripMs = Region.Value;
+		}
+	}
+	return ClosestRoundTripMs != MAX_uint32;
+}
+
+bool FPlayFabLobby::EstimateSearchResultPing(FOnlineSessionSearchResult& SearchResult, const TMap<FString, uint32>& RegionRoundTripMs) const
+{
+	// Party traffic is relayed through the host's region, so our round trip to it is the latency we would play at
+	FString HostRegion;
+	const uint32* RoundTripMs = SearchResult.Session.SessionSettings.Get(SETTING_HOST_REGION, HostRegion) ? RegionRoundTripMs.Find(HostRegion) : nullptr;
+	SearchResult.PingInMs = RoundTripMs ? static_cast<int32>(FMath::Min<uint32>(*RoundTripMs, MAX_QUERY_PING)) : MAX_QUERY_PING;
+	return RoundTripMs != nullptr;
+}
+
+double FPlayFabLobby::ScoreSearchResult(const FOnlineSessionSearchResult& SearchResult) const
+{
+	// Lower scores rank first
+	double Score = SearchRankLatencyWeight * SearchResult.PingInMs;
+
+	const int32 MaxMembers = SearchResult.Session.SessionSettings.NumPublicConnections;
+	if (MaxMembers > 0)
+	{
+		const double Fill = static_cast<double>(MaxMembers - SearchResult.Session.NumOpenPublicConnections) / MaxMembers;
+		Score -= SearchRankFillWeight * Fill;
+	}
+
+	for (const TPair<FName, float>& SettingWeight : SearchRankSettingWeights)
+	{
+		const FOnlineSessionSetting* Setting = SearchResult.Session.SessionSettings.Settings.Find(SettingWeight.Key);
+		double Value;
+		if (Setting && GetSearchValueAsNumber(Setting->Data, Value))
+		{
+			Score += SettingWeight.Value * Value;
+		}
+	}
+	return Score;
+}
+
+void FPlayFabLobby::RankLobbySearchResults(TArray<FOnlineSessionSearchResult>& SearchResults) const
+{
+	if (!bEnableLatencyRankedSearch || SearchResults.Num() == 0)
+	{
+		return;
+	}
+
+	TMap<FString, uint32> RegionRoundTripMs;
+	OSSPlayFab->GetRegionRoundTripTimes(RegionRoundTripMs);
+
+	TArray<double> Scores;
+	Scores.SetNumUninitialized(SearchResults.Num());
+	int32 EstimatedCount = 0;
+	for (int32 ResultIndex = 0; ResultIndex < SearchResults.Num(); ++ResultIndex)
+	{
+		EstimatedCount += EstimateSearchResultPing(SearchResults[ResultIndex], RegionRoundTripMs) ? 1 : 0;
+		Scores[ResultIndex] = ScoreSearchResult(SearchResults[ResultIndex]);
+	}
+
+	// Equal scores keep the order the service and the local predicates produced
+	TArray<int32> Order;
+	Order.SetNumUninitialized(SearchResults.Num());
+	for (int32 ResultIndex = 0; ResultIndex < Order.Num(); ++ResultIndex)
+	{
+		Order[ResultIndex] = ResultIndex;
+	}
+	Algo::StableSortBy(Order, [&Scores](int32 ResultIndex) { return Scores[ResultIndex]; });
+
+	TArray<FOnlineSessionSearchResult> RankedResults;
+	RankedResults.Reserve(SearchResults.Num());
+	for (int32 ResultIndex : Order)
+	{
+		RankedResults.Add(MoveTemp(SearchResults[ResultIndex]));
+	}
+	SearchResults = MoveTemp(RankedResults);
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::RankLobbySearchResults: Ranked %d results, %d with an estimated latency, best %dms"), SearchResults.Num(), EstimatedCount, SearchResults[0].PingInMs);
+}
+
+bool FPlayFabLobby::PingSearchResult(const FOnlineSessionSearchResult& SearchResult)
+{
+	TMap<FString, uint32> RegionRoundTripMs;
+	if (!OSSPlayFab->GetRegionRoundTripTimes(RegionRoundTripMs) || !CurrentSessionSearch.IsValid())
+	{
+		return false;
+	}
+
+	// The estimate is refreshed on the result held by the current search, which is what callers read
+	const FString SessionId = SearchResult.GetSessionIdStr();
+	for (FOnlineSessionSearchResult& CurrentResult : CurrentSessionSearch->SearchResults)
+	{
+		if (CurrentResult.GetSessionIdStr() == SessionId)
+		{
+			return EstimateSearchResultPing(CurrentResult, RegionRoundTripMs);
+		}
+	}
+	return false;
 }
 
 void FPlayFabLobby::OnGetPlayFabIDsFromPlatformIDsCompleted(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded, FPendingSendInviteData PendingSendInvite)
@@ -1872,38 +2814,334 @@ void  FPlayFabLobby::InviteTitleAccountIDsToLobby(FPendingSendInviteData Pending
 
 void FPlayFabLobby::BuildSearchKeyMappingTable()
 {
-	int32 SizeOfMappingTable = sizeof(s_SearchKeyMappingTable) / sizeof(struct FSearchKeyMappingTable);
-	for (int32 i = 0; i < SizeOfMappingTable; ++ i)
+	for (const FSearchKeyMappingTable& Mapping : s_SearchKeyMappingTable)
 	{
-		FString SearchKey;
-		switch (s_SearchKeyMappingTable[i].Type)
+		const FString Prefix = Mapping.Type == EOnlineKeyValuePairDataType::String ? SEARCH_KEY_PREFIX_STRING : SEARCH_KEY_PREFIX_NUMBER;
+		AddSearchKeyMapping(Mapping.SettingKey, FString::Printf(TEXT("%skey%d"), *Prefix, Mapping.KeyNumber), Mapping.Type);
+	}
+
+	AddSearchKeyMappingsFromConfig();
+
+	// Latency ranking needs every lobby to carry its host's region
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableLatencyRankedSearch"), bEnableLatencyRankedSearch, GEngineIni);
+	if (bEnableLatencyRankedSearch)
+	{
+		GConfig->GetString(TEXT("OnlineSubsystemPlayFab"), TEXT("HostRegionSearchKey"), HostRegionSearchKey, GEngineIni);
+		if (HostRegionSearchKey.IsEmpty())
 		{
-			case EOnlineKeyValuePairDataType::Bool:
-			case EOnlineKeyValuePairDataType::Int32:
-				SearchKey = FString::Printf(TEXT("%skey%d"), *SEARCH_KEY_PREFIX_NUMBER, s_SearchKeyMappingTable[i].KeyNumber);
-				break;
-			case EOnlineKeyValuePairDataType::String:
-				SearchKey = FString::Printf(TEXT("%skey%d"), *SEARCH_KEY_PREFIX_STRING, s_SearchKeyMappingTable[i].KeyNumber);
-				break;
+			UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::BuildSearchKeyMappingTable: bEnableLatencyRankedSearch needs HostRegionSearchKey set to a string search key, latency ranking is disabled"));
+			bEnableLatencyRankedSearch = false;
+		}
+		else
+		{
+			bEnableLatencyRankedSearch = AddSearchKeyMapping(SETTING_HOST_REGION, HostRegionSearchKey, EOnlineKeyValuePairDataType::String);
+		}
+	}
+
+	// Unmapped keys come back as string settings named after the key itself
+	for (int32 KeyNumber = 1; KeyNumber <= MaxSearchKeyNumber; ++KeyNumber)
+	{
+		StringSearchKeyDecoders[KeyNumber].SettingName = FName(*FString::Printf(TEXT("%skey%d"), *SEARCH_KEY_PREFIX_STRING, KeyNumber));
+		NumberSearchKeyDecoders[KeyNumber].SettingName = FName(*FString::Printf(TEXT("%skey%d"), *SEARCH_KEY_PREFIX_NUMBER, KeyNumber));
+	}
+
+	for (const TPair<FString, TPair<FString, EOnlineKeyValuePairDataType::Type>>& Mapping : SearchKeyMappingTable)
+	{
+		if (FSearchKeyDecoder* Decoder = FindSearchKeyDecoder(TCHAR_TO_UTF8(*Mapping.Key)))
+		{
+			Decoder->SettingName = FName(*Mapping.Value.Key);
+			Decoder->Type = Mapping.Value.Value;
+		}
+	}
+
+	auto SetSearchKeyRole = [this](const FString& SearchKey, ESearchKeyRole Role)
+	{
+		if (FSearchKeyDecoder* Decoder = FindSearchKeyDecoder(TCHAR_TO_UTF8(*SearchKey)))
+		{
+			Decoder->Role = Role;
+		}
+	};
+	SetSearchKeyRole(SEARCH_KEY_PLATFORM_ID, ESearchKeyRole::PlatformId);
+	SetSearchKeyRole(SEARCH_KEY_HOST_NICKNAME, ESearchKeyRole::HostNickname);
+#if defined(USES_NATIVE_SESSION)
+	SetSearchKeyRole(SEARCH_KEY_NATIVE_SESSIONID, ESearchKeyRole::NativeSessionId);
+	SetSearchKeyRole(SEARCH_KEY_NATIVE_PLATFORM, ESearchKeyRole::NativePlatform);
+#endif
+}
+
+static bool IsBuiltInSearchKeySetting(FName SettingName)
+{
+	for (const FSearchKeyMappingTable& Mapping : s_SearchKeyMappingTable)
+	{
+		if (Mapping.SettingKey == SettingName)
+		{
+			return true;
 		}
-		SearchKeyMappingTable.Add(SearchKey, TPair<FString, EOnlineKeyValuePairDataType::Type>(s_SearchKeyMappingTable[i].SettingKey.ToString(), s_SearchKeyMappingTable[i].Type));
 	}
+	return false;
 }
 
-bool FPlayFabLobby::GetSearchKeyFromSettingMappingTable(const FString& SettingKey, FString& SearchKey, EOnlineKeyValuePairDataType::Type& Type) const
+static bool ParseSearchKeyType(const FString& TypeName, EOnlineKeyValuePairDataType::Type& OutType)
 {
-	for (const auto& SearchFilter : SearchKeyMappingTable)
+	static const EOnlineKeyValuePairDataType::Type SupportedTypes[] =
+	{
+		EOnlineKeyValuePairDataType::String,
+		EOnlineKeyValuePairDataType::Bool,
+		EOnlineKeyValuePairDataType::Int32,
+		EOnlineKeyValuePairDataType::UInt32,
+		EOnlineKeyValuePairDataType::Int64,
+		EOnlineKeyValuePairDataType::Float,
+		EOnlineKeyValuePairDataType::Double,
+	};
+
+	for (EOnlineKeyValuePairDataType::Type SupportedType : SupportedTypes)
 	{
-		if (SearchFilter.Value.Key.Equals(SettingKey, ESearchCase::IgnoreCase))
+		if (TypeName.Equals(EOnlineKeyValuePairDataType::ToString(SupportedType), ESearchCase::IgnoreCase))
 		{
-			SearchKey = SearchFilter.Key;
-			Type = SearchFilter.Value.Value;
+			OutType = SupportedType;
 			return true;
 		}
 	}
 	return false;
 }
 
+void FPlayFabLobby::AddSearchKeyMappingsFromConfig()
+{
+	// Game settings are given their own slots without renaming them, e.g.
+	// [OnlineSubsystemPlayFab]
+	// +SearchKeyMappings=(Setting=SKILL,Key=number_key5,Type=Double)
+	TArray<FString> SearchKeyMappings;
+	GConfig->GetArray(TEXT("OnlineSubsystemPlayFab"), TEXT("SearchKeyMappings"), SearchKeyMappings, GEngineIni);
+	for (const FString& SearchKeyMapping : SearchKeyMappings)
+	{
+		FString SettingName;
+		FString SearchKey;
+		FString TypeName;
+		EOnlineKeyValuePairDataType::Type Type;
+		if (!FParse::Value(*SearchKeyMapping, TEXT("Setting="), SettingName) ||
+			!FParse::Value(*SearchKeyMapping, TEXT("Key="), SearchKey) ||
+			!FParse::Value(*SearchKeyMapping, TEXT("Type="), TypeName) ||
+			!ParseSearchKeyType(TypeName, Type))
+		{
+			UE_LOG_ONLINE(Error, TEXT("Engine INI OnlineSubsystemPlayFab section contains erroneous value for key SearchKeyMappings: %s"), *SearchKeyMapping);
+			continue;
+		}
+
+		if (AddSearchKeyMapping(FName(*SettingName), SearchKey, Type))
+		{
+			UE_LOG_ONLINE(Verbose, TEXT("FPlayFabLobby::AddSearchKeyMappingsFromConfig: %s is stored in %s as %s"), *SettingName, *SearchKey, EOnlineKeyValuePairDataType::ToString(Type));
+		}
+	}
+}
+
+bool FPlayFabLobby::AddSearchKeyMapping(FName SettingName, const FString& SearchKey, EOnlineKeyValuePairDataType::Type Type)
+{
+	if (FindSearchKeyDecoder(TCHAR_TO_UTF8(*SearchKey)) == nullptr)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s is not a lobby search key, setting %s is not searchable"), *SearchKey, *SettingName.ToString());
+		return false;
+	}
+
+	// Only number keys can be compared numerically by the service, so numbers never go in string keys and strings never in number keys
+	if (SearchKey.StartsWith(SEARCH_KEY_PREFIX_NUMBER) != (Type != EOnlineKeyValuePairDataType::String))
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s cannot hold %s setting %s"), *SearchKey, EOnlineKeyValuePairDataType::ToString(Type), *SettingName.ToString());
+		return false;
+	}
+
+	if (SearchKey == SEARCH_KEY_PLATFORM_ID || SearchKey == SEARCH_KEY_HOST_NICKNAME || SearchKey == SEARCH_KEY_NATIVE_SESSIONID || SearchKey == SEARCH_KEY_NATIVE_PLATFORM)
+	{
+		UE_LOG_ONLINE(Error, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s is reserved for the lobby owner, setting %s is not searchable"), *SearchKey, *SettingName.ToString());
+		return false;
+	}
+
+	// A later mapping takes the slot, or moves the setting, of an earlier one
+	if (const TPair<FString, EOnlineKeyValuePairDataType::Type>* PreviousSetting = SearchKeyMappingTable.Find(SearchKey))
+	{
+		// Built-in settings are searched by engine and game code that does not know its key was given away
+		if (IsBuiltInSearchKeySetting(FName(*PreviousSetting->Key)))
+		{
+			UE_LOG_ONLINE(Warning, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s replaces built-in setting %s in %s, %s is no longer searchable"), *SettingName.ToString(), *PreviousSetting->Key, *SearchKey, *PreviousSetting->Key);
+		}
+		else
+		{
+			UE_LOG_ONLINE(Log, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s replaces %s in %s"), *SettingName.ToString(), *PreviousSetting->Key, *SearchKey);
+		}
+		SettingSearchKeyMap.Remove(FName(*PreviousSetting->Key));
+	}
+	if (const FSettingSearchKey* PreviousSearchKey = SettingSearchKeyMap.Find(SettingName))
+	{
+		UE_LOG_ONLINE(Log, TEXT("FPlayFabLobby::AddSearchKeyMapping: %s moves from %s to %s"), *SettingName.ToString(), *PreviousSearchKey->SearchKey, *SearchKey);
+		SearchKeyMappingTable.Remove(PreviousSearchKey->SearchKey);
+	}
+
+	SearchKeyMappingTable.Add(SearchKey, TPair<FString, EOnlineKeyValuePairDataType::Type>(SettingName.ToString(), Type));
+	SettingSearchKeyMap.Add(SettingName, FSettingSearchKey{ SearchKey, Type });
+	return true;
+}
+
+bool FPlayFabLobby::EncodeSearchPropertyValue(const FVariantData& Value, EOnlineKeyValuePairDataType::Type Type, FString& OutValue)
+{
+	if (Type == EOnlineKeyValuePairDataType::String)
+	{
+		OutValue = Value.ToString();
+		return true;
+	}
+
+	// Read any numeric setting so it can be stored in a slot of a different numeric type
+	bool bIntegral = true;
+	int64 IntegerValue = 0;
+	double FloatingValue = 0.0;
+	switch (Value.GetType())
+	{
+		case EOnlineKeyValuePairDataType::Bool:
+		{
+			bool BoolValue;
+			Value.GetValue(BoolValue);
+			IntegerValue = BoolValue ? 1 : 0;
+			break;
+		}
+		case EOnlineKeyValuePairDataType::Int32:
+		{
+			int32 Int32Value;
+			Value.GetValue(Int32Value);
+			IntegerValue = Int32Value;
+			break;
+		}
+		case EOnlineKeyValuePairDataType::UInt32:
+		{
+			uint32 UInt32Value;
+			Value.GetValue(UInt32Value);
+			IntegerValue = UInt32Value;
+			break;
+		}
+		case EOnlineKeyValuePairDataType::Int64:
+			Value.GetValue(IntegerValue);
+			break;
+		case EOnlineKeyValuePairDataType::UInt64:
+		{
+			uint64 UInt64Value;
+			Value.GetValue(UInt64Value);
+			IntegerValue = static_cast<int64>(UInt64Value);
+			break;
+		}
+		case EOnlineKeyValuePairDataType::Float:
+		{
+			float FloatValue;
+			Value.GetValue(FloatValue);
+			FloatingValue = FloatValue;
+			bIntegral = false;
+			break;
+		}
+		case EOnlineKeyValuePairDataType::Double:
+			Value.GetValue(FloatingValue);
+			bIntegral = false;
+			break;
+		case EOnlineKeyValuePairDataType::String:
+		{
+			FString StringValue;
+			Value.GetValue(StringValue);
+			if (!StringValue.IsNumeric())
+			{
+				return false;
+			}
+			bIntegral = !StringValue.Contains(TEXT("."));
+			IntegerValue = FCString::Atoi64(*StringValue);
+			FloatingValue = FCString::Atod(*StringValue);
+			break;
+		}
+		default:
+			return false;
+	}
+	if (bIntegral)
+	{
+		FloatingValue = static_cast<double>(IntegerValue);
+	}
+	else
+	{
+		IntegerValue = static_cast<int64>(FloatingValue);
+	}
+
+	switch (Type)
+	{
+		case EOnlineKeyValuePairDataType::Bool:
+			OutValue = FloatingValue != 0.0 ? TEXT("1") : TEXT("0");
+			return true;
+		case EOnlineKeyValuePairDataType::Int32:
+		case EOnlineKeyValuePairDataType::UInt32:
+		case EOnlineKeyValuePairDataType::Int64:
+			OutValue = FString::Printf(TEXT("%lld"), static_cast<long long>(IntegerValue));
+			return true;
+		// Enough digits for the value to read back exactly
+		case EOnlineKeyValuePairDataType::Float:
+			OutValue = FString::Printf(TEXT("%.9g"), FloatingValue);
+			return true;
+		case EOnlineKeyValuePairDataType::Double:
+			OutValue = FString::Printf(TEXT("%.17g"), FloatingValue);
+			return true;
+		default:
+			return false;
+	}
+}
+
+void FPlayFabLobby::SetSessionSettingFromSearchProperty(FOnlineSessionSettings& SessionSettings, FName SettingName, EOnlineKeyValuePairDataType::Type Type, const char* Value)
+{
+	switch (Type)
+	{
+		case EOnlineKeyValuePairDataType::Bool:
+			SessionSettings.Set(SettingName, Value[0] == '1' ? true : false, EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		case EOnlineKeyValuePairDataType::Int32:
+			SessionSettings.Set(SettingName, FCStringAnsi::Atoi(Value), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		case EOnlineKeyValuePairDataType::UInt32:
+			SessionSettings.Set(SettingName, static_cast<uint32>(FCStringAnsi::Atoi64(Value)), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		case EOnlineKeyValuePairDataType::Int64:
+			SessionSettings.Set(SettingName, static_cast<int64>(FCStringAnsi::Atoi64(Value)), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		case EOnlineKeyValuePairDataType::Float:
+			SessionSettings.Set(SettingName, static_cast<float>(FCStringAnsi::Atod(Value)), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		case EOnlineKeyValuePairDataType::Double:
+			SessionSettings.Set(SettingName, FCStringAnsi::Atod(Value), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+		default:
+			SessionSettings.Set(SettingName, FString(UTF8_TO_TCHAR(Value)), EOnlineDataAdvertisementType::ViaOnlineService);
+			break;
+	}
+}
+
+const FPlayFabLobby::FSearchKeyDecoder* FPlayFabLobby::FindSearchKeyDecoder(const char* SearchKey) const
+{
+	// Search keys are string_key1 to string_key30 and number_key1 to number_key30
+	const FSearchKeyDecoder* Decoders = nullptr;
+	if (FCStringAnsi::Strncmp(SearchKey, "string_key", 10) == 0)
+	{
+		Decoders = StringSearchKeyDecoders;
+	}
+	else if (FCStringAnsi::Strncmp(SearchKey, "number_key", 10) == 0)
+	{
+		Decoders = NumberSearchKeyDecoders;
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	int32 KeyNumber = 0;
+	for (const char* Digit = SearchKey + 10; *Digit != '\0'; ++Digit)
+	{
+		if (*Digit < '0' || *Digit > '9' || KeyNumber > MaxSearchKeyNumber)
+		{
+			return nullptr;
+		}
+		KeyNumber = KeyNumber * 10 + (*Digit - '0');
+	}
+
+	return KeyNumber >= 1 && KeyNumber <= MaxSearchKeyNumber ? &Decoders[KeyNumber] : nullptr;
+}
+
 const TPair<FString, EOnlineKeyValuePairDataType::Type>* FPlayFabLobby::FindSearchKey(const FString& SearchKey) const
 {
 	return SearchKeyMappingTable.Find(SearchKey);
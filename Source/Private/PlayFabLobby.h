@@ -12,6 +12,7 @@
 #include "OnlineSubsystemPlayFabPrivate.h"
 
 class FPlayFabUser;
+class UTF8StringList;
 DECLARE_MULTICAST_DELEGATE_TwoParams(FOnLobbyCreatedAndJoinCompleted, bool, FName);
 typedef FOnLobbyCreatedAndJoinCompleted::FDelegate FOnLobbyCreatedAndJoinCompletedDelegate;
 
@@ -58,13 +59,18 @@ public:
 	bool JoinLobby(const FUniqueNetId& UserId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession);
 	bool JoinLobbyWithUser(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& SessionSettings);
 	bool JoinArrangedLobby(FName SessionName, const FOnlineMatchmakingTicketInfoPtr MatchTicket);
-	bool UpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings);
+	// bPostImmediately skips the coalescing window and minimum interval, for updates on the join critical path
+	bool UpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings, bool bPostImmediately = false);
 	bool AddLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate);
 	bool LeaveLobby(const FUniqueNetId& PlayerId, FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate, const FOnUnregisterLocalPlayerCompleteDelegate& UnregisterLocalPlayerCompleteDelegate, bool bDestroyingSession);
 	bool FindLobbies(const FUniqueNetId& UserId, TSharedPtr<FOnlineSessionSearch> SearchSettings);
 	bool FindFriendLobbies(const FUniqueNetId& UserId);
 	const TPair<FString, EOnlineKeyValuePairDataType::Type>* FindSearchKey(const FString& SearchKey) const;
 
+	// Search property values are encoded per the type of the setting's slot: number keys hold numbers the service can range filter
+	static bool EncodeSearchPropertyValue(const FVariantData& Value, EOnlineKeyValuePairDataType::Type Type, FString& OutValue);
+	static void SetSessionSettingFromSearchProperty(FOnlineSessionSettings& SessionSettings, FName SettingName, EOnlineKeyValuePairDataType::Type Type, const char* Value);
+
 	void RegisterForInvites_PlayFabMultiplayer(const PFEntityKey& ListenerEntity);
 	void UnregisterForInvites_PlayFabMultiplayer(const PFEntityKey& ListenerEntity);
 
@@ -98,6 +104,33 @@ PACKAGE_SCOPE:
 	DEFINE_ONLINE_DELEGATE_THREE_PARAM(OnFindLobbiesCompleted, int32, bool, TSharedPtr<FOnlineSessionSearch>);
 	DEFINE_ONLINE_DELEGATE_ONE_PARAM(OnLobbyDisconnected, FName);
 
+	FOnlineSessionSearchResult CreateSearchResultFromLobby(const PFLobbySearchResult& Lobby);
+
+	struct FCachedLobbySearchResult
+	{
+		uint32 ContentHash = 0;
+		FOnlineSessionSearchResult SearchResult;
+	};
+
+	// Converts a result set in chunks of LobbySearchConversionChunkSize on task graph workers, reusing unchanged PreviousLobbies.
+	// OutLobbies keeps the order of LobbySearchResults. Returns how many lobbies were reused without conversion.
+	uint32 ConvertLobbySearchResults(const PFLobbySearchResult* LobbySearchResults, uint32 LobbyCount, const TMap<FString, FCachedLobbySearchResult>* PreviousLobbies, TArray<FCachedLobbySearchResult>& OutLobbies, bool bAllowParallel = true);
+	bool bEnableParallelSearchConversion = true;
+	int32 LobbySearchConversionChunkSize = 8;
+
+	struct FSettingSearchKey
+	{
+		FString SearchKey;
+		EOnlineKeyValuePairDataType::Type Type;
+	};
+	const FSettingSearchKey* FindSearchKeyForSetting(FName SettingName) const { return SettingSearchKeyMap.Find(SettingName); }
+
+	// Opt-in (bEnableLatencyRankedSearch): hosts publish their closest Party region, searchers estimate each result's latency as their
+	// own round trip to that region, then order results by SearchRankLatencyWeight, SearchRankFillWeight and SearchRankSettingWeights
+	void RankLobbySearchResults(TArray<FOnlineSessionSearchResult>& SearchResults) const;
+	bool EstimateSearchResultPing(FOnlineSessionSearchResult& SearchResult, const TMap<FString, uint32>& RegionRoundTripMs) const;
+	bool PingSearchResult(const FOnlineSessionSearchResult& SearchResult);
+
 	/** Current search object */
 	TSharedPtr<FOnlineSessionSearch> CurrentSessionSearch;
 	int32 SearchingUserNum;
@@ -105,13 +138,88 @@ PACKAGE_SCOPE:
 private:
 	bool GetLobbyFromSession(const FName SessionName, PFLobbyHandle& LobbyHandle);
 	bool ValidateSessionForInvite(const FName SessionName);
-	FOnlineSessionSearchResult CreateSearchResultFromLobby(const PFLobbySearchResult& Lobby);
 	bool IsSearchKey(const FString& Name);
-	FString ComposeLobbySearchQueryFilter(const FSearchParams& SearchParams);
+
+	// A search parameter the service cannot evaluate: Near, In with several values, or one that no longer fits in the filter string.
+	// It is evaluated on the converted results, against the setting the search key decodes to.
+	struct FLocalSearchPredicate
+	{
+		FName SettingName;
+		EOnlineComparisonOp::Type ComparisonOp = EOnlineComparisonOp::Equals;
+		bool bNumeric = false;
+		TArray<double> NumberValues;
+		TArray<FString> StringValues;
+	};
+
+	// Filters planned from FSearchParams are cached as UTF-8, keyed by the query contents, since the same query is usually repeated
+	struct FCompiledLobbySearchFilter
+	{
+		TArray<ANSICHAR> FilterString;
+		TArray<FLocalSearchPredicate> LocalPredicates;
+		FString LocalPredicatesDescription;
+		int32 PushedPredicateCount = 0;
+		int32 IgnoredPredicateCount = 0;
+	};
+	const FCompiledLobbySearchFilter& GetCompiledSearchFilter(const FSearchParams& SearchParams);
+	void PlanLobbySearchQuery(const FSearchParams& SearchParams, FCompiledLobbySearchFilter& OutPlan);
+	void ApplyLocalSearchPredicates(const TArray<FLocalSearchPredicate>& LocalPredicates, TArray<FOnlineSessionSearchResult>& SearchResults) const;
+
+	// PFLobbySearchConfiguration::filterString cannot exceed 500 characters
+	static constexpr int32 MaxLobbySearchFilterLength = 500;
+	TMap<FString, FCompiledLobbySearchFilter> SearchFilterCache;
+	int32 SearchFilterCacheMaxEntries = 32;
+	uint32 SearchFilterCompileCount = 0;
+	uint32 SearchFilterCacheHitCount = 0;
+
+	// FindLobbies results keyed by searching entity and compiled filter. Entries younger than LobbySearchCacheTTL are served as is,
+	// for LobbySearchCacheStaleTime after that they are served while a background search refreshes them
+	struct FLobbySearchCacheEntry
+	{
+		// Keyed by lobby id
+		TMap<FString, FCachedLobbySearchResult> Lobbies;
+		double FetchTime = 0.0;
+		double FetchDuration = 0.0;
+		bool bRefreshing = false;
+	};
+
+	struct FPendingLobbySearch
+	{
+		FString CacheKey;
+		double StartTime = 0.0;
+		bool bBackgroundRefresh = false;
+		TArray<FLocalSearchPredicate> LocalPredicates;
+	};
+
+	TMap<FString, FLobbySearchCacheEntry> LobbySearchCache;
+	TMap<int32, FPendingLobbySearch> PendingLobbySearches;
+	int32 NextLobbySearchId = 0;
+	float LobbySearchCacheTTL = 0.0f;
+	float LobbySearchCacheStaleTime = 0.0f;
+	uint32 LobbySearchCacheHits = 0;
+	uint32 LobbySearchCacheStaleHits = 0;
+	uint32 LobbySearchCacheMisses = 0;
+	double LobbySearchCacheSecondsSaved = 0.0;
+
+	void ServeLobbySearchFromCache(const FLobbySearchCacheEntry& CacheEntry, double CacheAge, const TArray<FLocalSearchPredicate>& LocalPredicates, TSharedPtr<FOnlineSessionSearch> SearchSettings);
+	static uint32 HashLobbySearchResult(const PFLobbySearchResult& LobbySearchResult);
 	void BuildSearchKeyMappingTable();
-	bool GetSearchKeyFromSettingMappingTable(const FString& SettingKey, FString& SearchKey, EOnlineKeyValuePairDataType::Type& Type) const;
+	void AddSearchKeyMappingsFromConfig();
+	bool AddSearchKeyMapping(FName SettingName, const FString& SearchKey, EOnlineKeyValuePairDataType::Type Type);
 	EOnJoinSessionCompleteResult::Type ConvertMultiplayerErrorToJoinSessionResult(HRESULT result);
 
+	bool GetHostRegion(FString& OutRegion) const;
+	double ScoreSearchResult(const FOnlineSessionSearchResult& SearchResult) const;
+	bool bEnableLatencyRankedSearch = false;
+	// Every string search key already carries a built-in setting, so the title has to choose which one to give up
+	FString HostRegionSearchKey;
+	float SearchRankLatencyWeight = 1.0f;
+	float SearchRankFillWeight = 0.0f;
+	TMap<FName, float> SearchRankSettingWeights;
+
+	// Mirror the Lobby service limits so oversized requests fail up front instead of after a service round trip
+	bool ValidatePropertyLimits(const TCHAR* Operation, uint32 LobbyPropertyCount, uint32 SearchPropertyCount, uint32 MemberPropertyCount) const;
+	bool ValidateMaxMemberCount(const TCHAR* Operation, uint32 MaxMemberCount) const;
+
 	// we can eliminate this map if we pass SessionName as asyncIdentifier to lobby calls
 	TMap<PFLobbyHandle, FName> LobbySessionMap;
 
@@ -136,11 +244,40 @@ private:
 	};
 	FRemoveLocalPlayerData RemoveLocalPlayerData;
 
+	// Search key to setting, and setting to search key. FName keys hash and compare case-insensitively, as the settings did before
 	TMap<FString, TPair<FString, EOnlineKeyValuePairDataType::Type>> SearchKeyMappingTable;
+	TMap<FName, FSettingSearchKey> SettingSearchKeyMap;
+
+	// Search keys with a meaning beyond carrying a session setting
+	enum class ESearchKeyRole : uint8
+	{
+		Setting,
+		PlatformId,
+		HostNickname,
+		NativeSessionId,
+		NativePlatform
+	};
+
+	// Precomputed decoding of each search key back into a session setting, indexed by key number,
+	// so search results are converted without building strings for the keys
+	struct FSearchKeyDecoder
+	{
+		FName SettingName;
+		EOnlineKeyValuePairDataType::Type Type = EOnlineKeyValuePairDataType::String;
+		ESearchKeyRole Role = ESearchKeyRole::Setting;
+	};
+
+	static constexpr int32 MaxSearchKeyNumber = PFLobbyMaxSearchPropertyCount;
+	FSearchKeyDecoder StringSearchKeyDecoders[MaxSearchKeyNumber + 1];
+	FSearchKeyDecoder NumberSearchKeyDecoders[MaxSearchKeyNumber + 1];
+
+	const FSearchKeyDecoder* FindSearchKeyDecoder(const char* SearchKey) const;
+	FSearchKeyDecoder* FindSearchKeyDecoder(const char* SearchKey) { return const_cast<FSearchKeyDecoder*>(static_cast<const FPlayFabLobby*>(this)->FindSearchKeyDecoder(SearchKey)); }
 	
 	struct FUpdateLobbyCompletionState
 	{
 		int LobbyPostUpdateCount;
+		int LobbyPostCompletedCount;
 		bool MergedCompletionResult;
 	};
 
@@ -148,6 +285,72 @@ private:
 
 	std::atomic<int> NextUpdateLobbyOperationId {0};
 
+	// Content hashes of the properties last posted to each lobby, so UpdateLobby only sends changed and deleted keys
+	struct FPostedLobbyProperties
+	{
+		TMap<FString, uint32> LobbyProperties;
+		TMap<FString, uint32> SearchProperties;
+		// Keyed by member entity id
+		TMap<FString, TMap<FString, uint32>> MemberProperties;
+		PFLobbyAccessPolicy AccessPolicy = PFLobbyAccessPolicy::Private;
+		bool bOwnerPropertiesPosted = false;
+
+		void ResetOwnerProperties()
+		{
+			LobbyProperties.Reset();
+			SearchProperties.Reset();
+			bOwnerPropertiesPosted = false;
+		}
+	};
+
+	struct FLobbyUpdateDeltaStats
+	{
+		uint32 KeysSent = 0;
+		uint32 KeysDeleted = 0;
+		uint32 KeysSkipped = 0;
+		uint32 BytesSent = 0;
+	};
+
+	TMap<PFLobbyHandle, FPostedLobbyProperties> PostedLobbyProperties;
+	bool bEnableDeltaLobbyUpdates = true;
+
+	uint32 LobbyUpdateCount = 0;
+	uint64 LobbyUpdateKeysSent = 0;
+	uint64 LobbyUpdateKeysSkipped = 0;
+	uint64 LobbyUpdateBytesSent = 0;
+	uint32 LobbyUpdatePostsSaved = 0;
+
+	static bool IsSameEntity(const PFEntityKey& A, const PFEntityKey& B);
+	static void* MakeOperationContext(int OperationId);
+	static int GetOperationContextId(void* AsyncContext);
+
+	// Coalesces UpdateLobby calls per session: calls within LobbyUpdateCoalesceWindow merge into one update,
+	// posted no more often than LobbyUpdateMinInterval and with at most one update in flight per lobby
+	struct FLobbyUpdateSchedule
+	{
+		TOptional<FOnlineSessionSettings> PendingSettings;
+		double PendingSince = 0.0;
+		double LastPostTime = 0.0;
+		int32 PendingCallers = 0;
+		int32 InFlightCallers = 0;
+		bool bPostPendingImmediately = false;
+	};
+
+	TMap<FName, FLobbyUpdateSchedule> LobbyUpdateSchedules;
+	float LobbyUpdateCoalesceWindow = 0.0f;
+	float LobbyUpdateMinInterval = 0.0f;
+	uint32 LobbyUpdateCallsMerged = 0;
+	uint32 LobbyUpdatePostCount = 0;
+
+	bool InternalUpdateLobby(FName SessionName, const FOnlineSessionSettings& SessionSettings);
+	void GatherOwnerLobbyProperties(const FOnlineSessionSettings& SessionSettings, TMap<FString, FString>& LobbyProperties, TMap<FString, FString>& SearchProperties);
+	void TickLobbyUpdateSchedules();
+	void CompleteLobbyUpdate(FName SessionName, bool bWasSuccessful);
+	void CancelLobbyUpdates(FName SessionName);
+
+	static void AppendPropertyDelta(const TCHAR* PropertyType, const TMap<FString, FString>& Properties, TMap<FString, uint32>& PostedProperties, bool bFullUpload, UTF8StringList& Keys, UTF8StringList& Values, FLobbyUpdateDeltaStats& Stats);
+	bool FinishUpdateLobby(FName SessionName, int OperationId, const FUpdateLobbyCompletionState& UpdateLobbyCompletionState, const FLobbyUpdateDeltaStats& DeltaStats, bool bSucceededWithoutPost);
+
 public:
 	void OnGetPlayFabIDsFromPlatformIDsCompleted(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded, FPendingSendInviteData PendingSendInvite);
 	void OnGetTitleAccountIDsFromPlatformIDsCompleted(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded, FPendingSendInviteData PendingSendInvite);
@@ -13,6 +13,8 @@
 #include "OnlineSessionSettings.h"
 #include "Interfaces/OnlineSessionInterface.h"
 #include "OnlineSubsystemPlayfabPrivate.h"
+#include "OnlineSubsystemPlayFab.h"
+#include "PlayFabSocket.h"
 
 #include "Runtime/Launch/Resources/Version.h"
 
@@ -58,6 +60,8 @@ void UPlayFabNetConnection::InitLocalConnection(UNetDriver* InDriver, class FSoc
 	}
 
 	InitBase(InDriver, InSocket, InURL, InState, InMaxPacket, InPacketOverhead);
+	LoadNetSpeedAdaptationConfig();
+	LoadTrafficClassConfig();
 
 	FPlayFabSocketSubsystem* SocketSubsystem = static_cast<FPlayFabSocketSubsystem*>(InDriver->GetSocketSubsystem());
 	check(SocketSubsystem);
@@ -84,6 +88,8 @@ void UPlayFabNetConnection::InitRemoteConnection(UNetDriver* InDriver, class FSo
 	PlayerId.SetUniqueNetId(nullptr);
 
 	InitBase(InDriver, InSocket, InURL, InState, InMaxPacket, InPacketOverhead);
+	LoadNetSpeedAdaptationConfig();
+	LoadTrafficClassConfig();
 
 	RemoteAddr = InRemoteAddr.Clone();
 
@@ -112,4 +118,170 @@ void UPlayFabNetConnection::FlushNet(bool bIgnoreSimulation)
 	{
 		Super::FlushNet(bIgnoreSimulation);
 	}
+}
+
+void UPlayFabNetConnection::LowLevelSend(void* Data, int32 CountBits, FOutPacketTraits& Traits)
+{
+	FPlayFabSocket* PlayFabSocket = bFallbackToPlatformSocketSubsystem ? nullptr : static_cast<FPlayFabSocket*>(GetSocket());
+	if (PlayFabSocket == nullptr || !PlayFabSocket->IsTrafficClassificationEnabled())
+	{
+		Super::LowLevelSend(Data, CountBits, Traits);
+		return;
+	}
+
+	// The socket is shared by every connection of the driver, so the class only applies for the duration of this send.
+	// Anything sent directly by the driver (stateless handshake) keeps the Control class.
+	PlayFabSocket->SetTrafficClass(ClassifyOutgoingPacket(FMath::DivideAndRoundUp(CountBits, 8)));
+	Super::LowLevelSend(Data, CountBits, Traits);
+	PlayFabSocket->SetTrafficClass(EPlayFabTrafficClass::Control);
+}
+
+void UPlayFabNetConnection::LoadTrafficClassConfig()
+{
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("TrafficClassControlMaxBytes"), TrafficClassControlMaxBytes, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("TrafficClassBulkMinFraction"), TrafficClassBulkMinFraction, GEngineIni);
+
+	TrafficClassBulkMinFraction = FMath::Clamp(TrafficClassBulkMinFraction, 0.0f, 1.0f);
+}
+
+EPlayFabTrafficClass UPlayFabNetConnection::ClassifyOutgoingPacket(int32 PacketBytes) const
+{
+#if ENGINE_MAJOR_VERSION >= 5
+	const EConnectionState CurState = UNetConnection::GetConnectionState();
+#else
+	const EConnectionState CurState = State;
+#endif
+
+	// Connection setup and ack/keep-alive sized packets gate everything else, keep them at the front of the queue
+	if (CurState != USOCK_Open || PacketBytes <= TrafficClassControlMaxBytes)
+	{
+		return EPlayFabTrafficClass::Control;
+	}
+
+	if (MaxPacket > 0 && PacketBytes >= FMath::TruncToInt(MaxPacket * TrafficClassBulkMinFraction))
+	{
+		return EPlayFabTrafficClass::Bulk;
+	}
+
+	return EPlayFabTrafficClass::Interactive;
+}
+
+void UPlayFabNetConnection::LoadNetSpeedAdaptationConfig()
+{
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableNetSpeedAdaptation"), bNetSpeedAdaptationEnabled, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("NetSpeedAdaptationInterval"), NetSpeedAdaptationInterval, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("NetSpeedAdaptationQueuedBytesThreshold"), NetSpeedAdaptationQueuedBytesThreshold, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("NetSpeedAdaptationMinNetSpeed"), NetSpeedAdaptationMinNetSpeed, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("NetSpeedAdaptationDecreaseFactor"), NetSpeedAdaptationDecreaseFactor, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("NetSpeedAdaptationIncreaseFraction"), NetSpeedAdaptationIncreaseFraction, GEngineIni);
+
+	NetSpeedAdaptationDecreaseFactor = FMath::Clamp(NetSpeedAdaptationDecreaseFactor, 0.1f, 1.0f);
+	NetSpeedAdaptationIncreaseFraction = FMath::Clamp(NetSpeedAdaptationIncreaseFraction, 0.0f, 1.0f);
+	NetSpeedAdaptationQueuedBytesThreshold = FMath::Max(NetSpeedAdaptationQueuedBytesThreshold, 1);
+
+	TimeSinceLastNetSpeedSample = 0.0f;
+	NetSpeedCeiling = 0;
+	LastAppliedNetSpeed = 0;
+	LastTimedOutSendMessages = 0;
+	LastTimedOutSendMessageBytes = 0;
+	NetSpeedDecreaseCount = 0;
+	NetSpeedIncreaseCount = 0;
+}
+
+void UPlayFabNetConnection::UpdateNetSpeedFromPartyStatistics(float DeltaTime)
+{
+	if (!bNetSpeedAdaptationEnabled || bFallbackToPlatformSocketSubsystem || !RemoteAddr.IsValid())
+	{
+		return;
+	}
+
+#if ENGINE_MAJOR_VERSION >= 5
+	if (UNetConnection::GetConnectionState() != USOCK_Open)
+#else
+	if (State != USOCK_Open)
+#endif
+	{
+		return;
+	}
+
+	TimeSinceLastNetSpeedSample += DeltaTime;
+	if (TimeSinceLastNetSpeedSample < NetSpeedAdaptationInterval)
+	{
+		return;
+	}
+	TimeSinceLastNetSpeedSample = 0.0f;
+
+	FOnlineSubsystemPlayFab* OSSPlayFab = static_cast<FOnlineSubsystemPlayFab*>(IOnlineSubsystem::Get(PLAYFAB_SUBSYSTEM));
+	if (OSSPlayFab == nullptr || OSSPlayFab->LocalEndpoint == nullptr)
+	{
+		return;
+	}
+
+	uint32 EndpointId = 0;
+	RemoteAddr->GetIp(EndpointId);
+	PartyEndpoint** RemoteEndpoint = OSSPlayFab->Endpoints.Find(EndpointId);
+	if (RemoteEndpoint == nullptr || *RemoteEndpoint == nullptr || *RemoteEndpoint == OSSPlayFab->LocalEndpoint)
+	{
+		return;
+	}
+
+	const PartyEndpointStatistic StatisticTypes[] =
+	{
+		PartyEndpointStatistic::CurrentlyQueuedSendMessageBytes,
+		PartyEndpointStatistic::TimedOutSendMessages,
+		PartyEndpointStatistic::TimedOutSendMessageBytes
+	};
+	uint64 StatisticValues[UE_ARRAY_COUNT(StatisticTypes)] = {};
+
+	PartyEndpoint* TargetEndpoints[1] = { *RemoteEndpoint };
+	PartyError Err = OSSPlayFab->LocalEndpoint->GetEndpointStatistics(1, TargetEndpoints, UE_ARRAY_COUNT(StatisticTypes), StatisticTypes, StatisticValues);
+	if (PARTY_FAILED(Err))
+	{
+		UE_LOG(LogSockets, Verbose, TEXT("UPlayFabNetConnection::UpdateNetSpeedFromPartyStatistics: GetEndpointStatistics failed: %s"), *GetPartyErrorMessage(Err));
+		return;
+	}
+
+	const uint64 QueuedBytes = StatisticValues[0];
+	const uint64 TimedOutMessages = StatisticValues[1] - FMath::Min(StatisticValues[1], LastTimedOutSendMessages);
+	const uint64 TimedOutBytes = StatisticValues[2] - FMath::Min(StatisticValues[2], LastTimedOutSendMessageBytes);
+	LastTimedOutSendMessages = StatisticValues[1];
+	LastTimedOutSendMessageBytes = StatisticValues[2];
+
+	// The engine owns the configured rate; re-baseline whenever it changes it underneath us (e.g. NMT_Netspeed)
+	if (NetSpeedCeiling == 0 || CurrentNetSpeed != LastAppliedNetSpeed)
+	{
+		NetSpeedCeiling = CurrentNetSpeed;
+		LastAppliedNetSpeed = CurrentNetSpeed;
+	}
+
+	const int32 MinNetSpeed = FMath::Min(NetSpeedAdaptationMinNetSpeed, NetSpeedCeiling);
+	int32 NewNetSpeed = CurrentNetSpeed;
+	if (TimedOutMessages > 0 || QueuedBytes > static_cast<uint64>(NetSpeedAdaptationQueuedBytesThreshold))
+	{
+		// Multiplicative decrease as soon as the Party queue backs up or starts dropping
+		NewNetSpeed = FMath::Max(MinNetSpeed, FMath::TruncToInt(CurrentNetSpeed * NetSpeedAdaptationDecreaseFactor));
+	}
+	else if (QueuedBytes < static_cast<uint64>(NetSpeedAdaptationQueuedBytesThreshold / 4) && CurrentNetSpeed < NetSpeedCeiling)
+	{
+		// Additive increase back towards the engine configured rate once the queue has drained
+		NewNetSpeed = FMath::Min(NetSpeedCeiling, CurrentNetSpeed + FMath::Max(1, FMath::TruncToInt(NetSpeedCeiling * NetSpeedAdaptationIncreaseFraction)));
+	}
+
+	if (NewNetSpeed != CurrentNetSpeed)
+	{
+		if (NewNetSpeed < CurrentNetSpeed)
+		{
+			++NetSpeedDecreaseCount;
+		}
+		else
+		{
+			++NetSpeedIncreaseCount;
+		}
+
+		UE_LOG(LogSockets, Log, TEXT("UPlayFabNetConnection::UpdateNetSpeedFromPartyStatistics: Endpoint %u NetSpeed %d -> %d (Ceiling:%d QueuedBytes:%llu TimedOutMessages:%llu TimedOutBytes:%llu Decreases:%u Increases:%u)"),
+			EndpointId, CurrentNetSpeed, NewNetSpeed, NetSpeedCeiling, QueuedBytes, TimedOutMessages, TimedOutBytes, NetSpeedDecreaseCount, NetSpeedIncreaseCount);
+
+		CurrentNetSpeed = NewNetSpeed;
+		LastAppliedNetSpeed = NewNetSpeed;
+	}
 }
\ No newline at end of file
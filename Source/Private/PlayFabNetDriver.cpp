@@ -9,6 +9,7 @@
 #include "OnlineSubsystemPlayFabPrivate.h"
 #include "OnlineSubsystemSessionSettings.h"
 #include "PlayFabSocket.h"
+#include "PlayFabNetConnection.h"
 
 UPlayFabNetDriver::UPlayFabNetDriver(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
@@ -94,6 +95,24 @@ void UPlayFabNetDriver::Shutdown()
 void UPlayFabNetDriver::TickDispatch(float DeltaTime)
 {
 	Super::TickDispatch(DeltaTime);
+
+	if (bFallbackToPlatformSocketSubsystem)
+	{
+		return;
+	}
+
+	if (UPlayFabNetConnection* PlayFabServerConnection = Cast<UPlayFabNetConnection>(ServerConnection))
+	{
+		PlayFabServerConnection->UpdateNetSpeedFromPartyStatistics(DeltaTime);
+	}
+
+	for (UNetConnection* ClientConnection : ClientConnections)
+	{
+		if (UPlayFabNetConnection* PlayFabClientConnection = Cast<UPlayFabNetConnection>(ClientConnection))
+		{
+			PlayFabClientConnection->UpdateNetSpeedFromPartyStatistics(DeltaTime);
+		}
+	}
 }
 
 FOnlineSubsystemPlayFab* UPlayFabNetDriver::GetOnlineSubsystemPlayFab()
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSubsystemPlayFabPackage.h"
+
+class FArchive;
+class FPlayFabSocket;
+
+enum class EPlayFabPacketDirection : uint8
+{
+	Outgoing,	// FPlayFabSocket::SendTo
+	Incoming	// FPlayFabSocket::AddNewPendingData
+};
+
+struct FPlayFabCapturedPacket
+{
+	EPlayFabPacketDirection Direction = EPlayFabPacketDirection::Outgoing;
+	double Timestamp = 0.0;
+	uint16 LocalEndpointId = 0;
+	uint16 RemoteEndpointId = 0;
+	TArray<uint8> Payload;
+};
+
+/**
+ * Records socket traffic to a compact binary file:
+ *   header:  uint32 magic, uint32 version, int64 capture start (UTC ticks)
+ *   records: uint8 direction, packed uint32 microseconds since previous record,
+ *            uint16 local endpoint, uint16 remote endpoint, packed uint32 size, payload
+ */
+class FPlayFabPacketCapture
+{
+PACKAGE_SCOPE:
+	static const uint32 FileMagic;
+	static const uint32 FileVersion;
+
+public:
+	~FPlayFabPacketCapture();
+
+	bool Start(const FString& InFilename);
+	void Stop();
+	bool IsCapturing() const { return Writer.IsValid(); }
+
+	void RecordPacket(EPlayFabPacketDirection Direction, uint16 LocalEndpointId, uint16 RemoteEndpointId, const uint8* Data, int32 Count);
+
+	static FString GetDefaultFilename();
+
+private:
+	TUniquePtr<FArchive> Writer;
+	FString Filename;
+	double LastRecordTime = 0.0;
+	uint64 RecordedPackets = 0;
+	uint64 RecordedBytes = 0;
+};
+
+/**
+ * Injects a capture's incoming packets into the live socket at their original pace, following the game clock.
+ * This is a debugging aid, not a deterministic benchmark, and only runs while no Party network is connected, so captured
+ * endpoint ids cannot reach real peers. The net driver drops packets for connections whose handshake did not happen here.
+ */
+class FPlayFabPacketReplay
+{
+public:
+	bool Load(const FString& InFilename);
+
+	// Delivers every incoming packet that is due, returns false once the capture is exhausted
+	bool Tick(float DeltaTime, FPlayFabSocket* Socket);
+
+private:
+	TArray<FPlayFabCapturedPacket> Packets;
+	FString Filename;
+	int32 NextPacketIndex = 0;
+	double ElapsedTime = 0.0;
+	uint64 ReplayedPackets = 0;
+	uint64 ReplayedBytes = 0;
+	uint64 SkippedOutgoingPackets = 0;
+};
@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PlayFabRegionLatencyCache.h"
+#include "PlayFabHelpers.h"
+#include "OnlineSubsystemPlayFab.h"
+
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+FPlayFabRegionLatencyCache::FPlayFabRegionLatencyCache() :
+	Filename(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("PlayFab"), TEXT("RegionLatency.json")))
+{
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("RegionLatencyCacheMaxAge"), MaxAgeSeconds, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("RegionLatencyCacheMaxRegions"), MaxPreferredRegions, GEngineIni);
+}
+
+void FPlayFabRegionLatencyCache::Load()
+{
+	FString Contents;
+	if (!FFileHelper::LoadFileToString(Contents, *Filename))
+	{
+		return;
+	}
+
+	TSharedPtr<FJsonObject> Root;
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Contents);
+	if (!FJsonSerializer::Deserialize(Reader, Root) || !Root.IsValid())
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabRegionLatencyCache::Load: %s is not valid JSON"), *Filename);
+		return;
+	}
+
+	FString Timestamp;
+	if (!Root->TryGetStringField(TEXT("Timestamp"), Timestamp) || !FDateTime::ParseIso8601(*Timestamp, MeasuredTime))
+	{
+		return;
+	}
+
+	Regions.Reset();
+	const TArray<TSharedPtr<FJsonValue>>* RegionValues = nullptr;
+	if (Root->TryGetArrayField(TEXT("Regions"), RegionValues))
+	{
+		for (const TSharedPtr<FJsonValue>& RegionValue : *RegionValues)
+		{
+			const TSharedPtr<FJsonObject>* RegionObject = nullptr;
+			FRegionLatency Region;
+			if (RegionValue->TryGetObject(RegionObject) &&
+				(*RegionObject)->TryGetStringField(TEXT("Name"), Region.Name) &&
+				(*RegionObject)->TryGetNumberField(TEXT("RoundTripMs"), Region.RoundTripMs))
+			{
+				Regions.Add(Region);
+			}
+		}
+	}
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabRegionLatencyCache::Load: %d regions measured %s"), Regions.Num(), *MeasuredTime.ToIso8601());
+}
+
+void FPlayFabRegionLatencyCache::Save() const
+{
+	TSharedPtr<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Timestamp"), MeasuredTime.ToIso8601());
+
+	TArray<TSharedPtr<FJsonValue>> RegionValues;
+	for (const FRegionLatency& Region : Regions)
+	{
+		TSharedPtr<FJsonObject> RegionObject = MakeShared<FJsonObject>();
+		RegionObject->SetStringField(TEXT("Name"), Region.Name);
+		RegionObject->SetNumberField(TEXT("RoundTripMs"), Region.RoundTripMs);
+		RegionValues.Add(MakeShared<FJsonValueObject>(RegionObject));
+	}
+	Root->SetArrayField(TEXT("Regions"), RegionValues);
+
+	if (!FFileHelper::SaveStringToFile(SerializeRequestJson(Root), *Filename))
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabRegionLatencyCache::Save: Failed to write %s"), *Filename);
+	}
+}
+
+void FPlayFabRegionLatencyCache::UpdateFromParty()
+{
+	uint32_t RegionCount = 0;
+	const PartyRegion* PartyRegions = nullptr;
+	PartyError Err = PartyManager::GetSingleton().GetRegions(&RegionCount, &PartyRegions);
+	if (PARTY_FAILED(Err))
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabRegionLatencyCache::UpdateFromParty: GetRegions failed: %s"), *GetPartyErrorMessage(Err));
+		return;
+	}
+
+	if (RegionCount == 0)
+	{
+		return;
+	}
+
+	Regions.Reset(RegionCount);
+	for (uint32_t RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		FRegionLatency& Region = Regions.AddDefaulted_GetRef();
+		Region.Name = UTF8_TO_TCHAR(PartyRegions[RegionIndex].regionName);
+		Region.RoundTripMs = PartyRegions[RegionIndex].roundTripLatencyInMilliseconds;
+	}
+	Regions.Sort([](const FRegionLatency& A, const FRegionLatency& B) { return A.RoundTripMs < B.RoundTripMs; });
+	MeasuredTime = FDateTime::UtcNow();
+
+	UE_LOG_ONLINE(Verbose, TEXT("FPlayFabRegionLatencyCache::UpdateFromParty: %d regions, closest %s at %ums"), Regions.Num(), *Regions[0].Name, Regions[0].RoundTripMs);
+	Save();
+}
+
+bool FPlayFabRegionLatencyCache::IsFresh() const
+{
+	return Regions.Num() > 0 && (FDateTime::UtcNow() - MeasuredTime).GetTotalSeconds() <= MaxAgeSeconds;
+}
+
+bool FPlayFabRegionLatencyCache::GetRoundTripTimes(TMap<FString, uint32>& OutRoundTripMs) const
+{
+	OutRoundTripMs.Reset();
+	if (!IsFresh())
+	{
+		return false;
+	}
+
+	for (const FRegionLatency& Region : Regions)
+	{
+		OutRoundTripMs.Add(Region.Name, Region.RoundTripMs);
+	}
+	return true;
+}
+
+bool FPlayFabRegionLatencyCache::GetPreferredRegions(TArray<PartyRegion>& OutRegions) const
+{
+	OutRegions.Reset();
+	if (!IsFresh() || MaxPreferredRegions <= 0)
+	{
+		return false;
+	}
+
+	for (int32 RegionIndex = 0; RegionIndex < FMath::Min(Regions.Num(), MaxPreferredRegions); ++RegionIndex)
+	{
+		PartyRegion& Region = OutRegions.AddZeroed_GetRef();
+		FCStringAnsi::Strncpy(Region.regionName, TCHAR_TO_UTF8(*Regions[RegionIndex].Name), UE_ARRAY_COUNT(Region.regionName));
+		Region.roundTripLatencyInMilliseconds = Regions[RegionIndex].RoundTripMs;
+	}
+	return true;
+}
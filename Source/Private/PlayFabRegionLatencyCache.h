@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlayFabSDKIncludes.h"
+
+/**
+ * Keeps the region round trip times Party measured on a previous launch, so a new network can be
+ * created in the closest regions without waiting for Party to probe them again.
+ * Stored as JSON under Saved/PlayFab and ignored once older than RegionLatencyCacheMaxAge.
+ */
+class FPlayFabRegionLatencyCache
+{
+public:
+	FPlayFabRegionLatencyCache();
+
+	void Load();
+
+	// Takes the latest measurements from PartyManager::GetRegions and persists them
+	void UpdateFromParty();
+
+	// Closest regions first, false if there is no fresh data to use
+	bool GetPreferredRegions(TArray<PartyRegion>& OutRegions) const;
+
+	// Round trip time to every measured region, false if there is no fresh data to use
+	bool GetRoundTripTimes(TMap<FString, uint32>& OutRoundTripMs) const;
+
+	bool IsFresh() const;
+	float GetMaxAgeSeconds() const { return MaxAgeSeconds; }
+
+private:
+	struct FRegionLatency
+	{
+		FString Name;
+		uint32 RoundTripMs = 0;
+	};
+
+	void Save() const;
+
+	TArray<FRegionLatency> Regions;
+	FDateTime MeasuredTime;
+	FString Filename;
+	float MaxAgeSeconds = 86400.0f;
+	int32 MaxPreferredRegions = 3;
+};
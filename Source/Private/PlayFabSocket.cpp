@@ -5,9 +5,25 @@
 #include "PlayFabSocket.h"
 #include "PlayFabSocketSubsystem.h"
 #include "OnlineSubsystemPlayFab.h"
+#include "PlayFabPacketCapture.h"
 
 const uint32 FPlayFabSocket::SendTimeout = 500;
 
+const TCHAR* LexToString(EPlayFabTrafficClass TrafficClass)
+{
+	switch (TrafficClass)
+	{
+	case EPlayFabTrafficClass::Control:
+		return TEXT("Control");
+	case EPlayFabTrafficClass::Interactive:
+		return TEXT("Interactive");
+	case EPlayFabTrafficClass::Bulk:
+		return TEXT("Bulk");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
 FPlayFabSocket::FPlayFabSocket(FOnlineSubsystemPlayFab* InOSSPlayFab, const FString& InSocketDescription, const FName& InSocketProtocol) :
 	FSocket(SOCKTYPE_Datagram, InSocketDescription, InSocketProtocol),
 	OSSPlayFab(InOSSPlayFab),
@@ -18,10 +34,61 @@ FPlayFabSocket::FPlayFabSocket(FOnlineSubsystemPlayFab* InOSSPlayFab, const FStr
 	PartyQueueConfiguration.priority = Party::c_maxSendMessageQueuingPriority;
 	PartyQueueConfiguration.identityForCancelFilters = static_cast<uint32>(reinterpret_cast<uintptr_t>(this));
 	PartyQueueConfiguration.timeoutInMilliseconds = SendTimeout;
+
+	LoadTrafficClassConfig();
+}
+
+void FPlayFabSocket::LoadTrafficClassConfig()
+{
+	for (FPlayFabTrafficClassSettings& Settings : TrafficClasses)
+	{
+		Settings.Priority = Party::c_maxSendMessageQueuingPriority;
+		Settings.TimeoutInMilliseconds = SendTimeout;
+	}
+
+	GConfig->GetBool(TEXT("OnlineSubsystemPlayFab"), TEXT("bEnableTrafficClasses"), bTrafficClassificationEnabled, GEngineIni);
+	if (!bTrafficClassificationEnabled)
+	{
+		return;
+	}
+
+	// Defaults keep control traffic ahead of gameplay traffic and let bulk replication yield to both
+	TrafficClasses[static_cast<int32>(EPlayFabTrafficClass::Interactive)].Priority = Party::c_maxSendMessageQueuingPriority - 1;
+	TrafficClasses[static_cast<int32>(EPlayFabTrafficClass::Bulk)].Priority = Party::c_defaultSendMessageQueuingPriority;
+
+	for (int32 ClassIndex = 0; ClassIndex < static_cast<int32>(EPlayFabTrafficClass::Count); ++ClassIndex)
+	{
+		FPlayFabTrafficClassSettings& Settings = TrafficClasses[ClassIndex];
+		const FString ClassName = LexToString(static_cast<EPlayFabTrafficClass>(ClassIndex));
+
+		int32 Priority = Settings.Priority;
+		int32 TimeoutInMilliseconds = Settings.TimeoutInMilliseconds;
+		GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), *FString::Printf(TEXT("TrafficClass%sPriority"), *ClassName), Priority, GEngineIni);
+		GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), *FString::Printf(TEXT("TrafficClass%sTimeoutMs"), *ClassName), TimeoutInMilliseconds, GEngineIni);
+
+		Settings.Priority = static_cast<int8>(FMath::Clamp(Priority, static_cast<int32>(Party::c_minSendMessageQueuingPriority), static_cast<int32>(Party::c_maxSendMessageQueuingPriority)));
+		Settings.TimeoutInMilliseconds = static_cast<uint32>(FMath::Max(TimeoutInMilliseconds, 0));
+
+		UE_LOG(LogSockets, Verbose, TEXT("FPlayFabSocket::LoadTrafficClassConfig: %s priority %d timeout %ums"), *ClassName, Settings.Priority, Settings.TimeoutInMilliseconds);
+	}
 }
 
 FPlayFabSocket::~FPlayFabSocket()
 {
+	if (LoopbackPacketsSent > 0 || LoopbackPacketsReceived > 0)
+	{
+		UE_LOG(LogSockets, Log, TEXT("FPlayFabSocket: Loopback sent %llu packets (%llu bytes), received %llu packets"), LoopbackPacketsSent, LoopbackBytesSent, LoopbackPacketsReceived);
+	}
+
+	if (bTrafficClassificationEnabled)
+	{
+		for (int32 ClassIndex = 0; ClassIndex < static_cast<int32>(EPlayFabTrafficClass::Count); ++ClassIndex)
+		{
+			const FPlayFabTrafficClassSettings& Settings = TrafficClasses[ClassIndex];
+			UE_LOG(LogSockets, Log, TEXT("FPlayFabSocket: Traffic class %s sent %llu messages (%llu bytes)"), LexToString(static_cast<EPlayFabTrafficClass>(ClassIndex)), Settings.SentMessages, Settings.SentBytes);
+		}
+	}
+
 	PendingPackets.Empty();
 	Close();
 }
@@ -47,6 +114,19 @@ bool FPlayFabSocket::SendTo(const uint8* Data, int32 Count, int32& BytesSent, co
 		return false;
 	}
 
+	uint32 EndpointId;
+	Destination.GetIp(EndpointId);
+	const int32 DestinationPort = Destination.GetPort();
+
+	uint16 LocalEndpointId = 0;
+	const bool bHasLocalEndpointId = GetLocalEndpointId(LocalEndpointId);
+
+	// A loopback port names a socket in this process, so it is routed without Party or a local endpoint
+	if (SocketSubsystem->IsLoopbackPort(DestinationPort))
+	{
+		return SendToLoopback(Data, Count, BytesSent, LocalEndpointId, DestinationPort);
+	}
+
 	if (LocalEndpoint == nullptr)
 	{
 		UE_LOG(LogSockets, Verbose, TEXT("FPlayFabSocket::SendTo failed, LocalEnpoint was null"));
@@ -54,8 +134,17 @@ bool FPlayFabSocket::SendTo(const uint8* Data, int32 Count, int32& BytesSent, co
 		return false;
 	}
 
-	uint32 EndpointId;
-	Destination.GetIp(EndpointId);
+	// Traffic addressed to our own endpoint (e.g. a second net driver in this process) never needs to go through Party
+	if (bHasLocalEndpointId && EndpointId == LocalEndpointId)
+	{
+		return SendToLoopback(Data, Count, BytesSent, LocalEndpointId, DestinationPort);
+	}
+
+	if (SocketSubsystem->IsCapturingPackets())
+	{
+		SocketSubsystem->RecordPacket(EPlayFabPacketDirection::Outgoing, LocalEndpointId, static_cast<uint16>(EndpointId), Data, Count);
+	}
+
 	PartyEndpoint* RemoteEndpoint = OSSPlayFab->GetPartyEndpoint(EndpointId);
 	if (RemoteEndpoint == nullptr)
 	{
@@ -71,6 +160,10 @@ bool FPlayFabSocket::SendTo(const uint8* Data, int32 Count, int32& BytesSent, co
 		return false;
 	}
 
+	FPlayFabTrafficClassSettings& TrafficClassSettings = TrafficClasses[static_cast<int32>(CurrentTrafficClass)];
+	PartyQueueConfiguration.priority = TrafficClassSettings.Priority;
+	PartyQueueConfiguration.timeoutInMilliseconds = TrafficClassSettings.TimeoutInMilliseconds;
+
 	int TargetEndPointCount = 1;
 	Party::PartyEndpoint* TargetEndpoints[1] = { RemoteEndpoint };
 
@@ -100,12 +193,41 @@ bool FPlayFabSocket::SendTo(const uint8* Data, int32 Count, int32& BytesSent, co
 		UE_LOG(LogSockets, Warning, TEXT("FPlayFabSocket::SendTo %d bytes: %d"), EndpointId, Count);
 #endif
 
+		TrafficClassSettings.SentMessages++;
+		TrafficClassSettings.SentBytes += Count;
+
 		BytesSent = Count;
 		SocketSubsystem->LastSocketError = SE_NO_ERROR;
 		return true;
 	}
 }
 
+bool FPlayFabSocket::SendToLoopback(const uint8* Data, int32 Count, int32& BytesSent, uint16 LocalEndpointId, int32 DestinationPort)
+{
+	if (SocketSubsystem->IsCapturingPackets())
+	{
+		SocketSubsystem->RecordPacket(EPlayFabPacketDirection::Outgoing, LocalEndpointId, LocalEndpointId, Data, Count);
+	}
+
+	if (!SocketSubsystem->DeliverLoopbackPacket(this, LocalEndpointId, DestinationPort, Data, Count))
+	{
+		// No other socket in this process is addressed by the destination, same as sending to ourselves
+		SocketSubsystem->LastSocketError = SE_NO_ERROR;
+		return false;
+	}
+
+#if OSS_PLAYFAB_VERBOSE_PACKET_LEVEL_LOGGING
+	UE_LOG(LogSockets, Warning, TEXT("FPlayFabSocket::SendToLoopback %d port %d bytes: %d"), LocalEndpointId, DestinationPort, Count);
+#endif
+
+	LoopbackPacketsSent++;
+	LoopbackBytesSent += Count;
+
+	BytesSent = Count;
+	SocketSubsystem->LastSocketError = SE_NO_ERROR;
+	return true;
+}
+
 bool FPlayFabSocket::Send(const uint8* Data, int32 Count, int32& BytesSent)
 {
 	// Not supported
@@ -132,7 +254,7 @@ bool FPlayFabSocket::RecvFrom(uint8* Data, int32 BufferSize, int32& BytesRead, F
 	}
 
 	Source.SetIp(CurrentPacket.SourceEndpoint);
-	Source.SetPort(CurrentPacket.SourceEndpoint);
+	Source.SetPort(CurrentPacket.SourcePort);
 	BytesRead = CurrentPacket.Data.Num();
 	FMemory::Memcpy(Data, CurrentPacket.Data.GetData(), BytesRead);
 
@@ -171,25 +293,37 @@ ESocketConnectionState FPlayFabSocket::GetConnectionState()
 int32 FPlayFabSocket::GetPortNo()
 {
 	uint16 EndpointId = 0;
+	GetLocalEndpointId(EndpointId);
 
-	if (LocalEndpoint)
+	return EndpointId;
+}
+
+bool FPlayFabSocket::GetLocalEndpointId(uint16& OutEndpointId)
+{
+	if (!bHasCachedLocalEndpointId && LocalEndpoint)
 	{
-		LocalEndpoint->GetUniqueIdentifier(&EndpointId);
+		bHasCachedLocalEndpointId = PARTY_SUCCEEDED(LocalEndpoint->GetUniqueIdentifier(&CachedLocalEndpointId));
 	}
 
-	return EndpointId;
+	OutEndpointId = CachedLocalEndpointId;
+	return bHasCachedLocalEndpointId;
 }
 
-void FPlayFabSocket::AddNewPendingData(uint16 SourceEndpoint, TArray<uint8> NewData)
+void FPlayFabSocket::AddNewPendingData(uint16 SourceEndpoint, TArray<uint8> NewData, int32 SourcePort /*= INDEX_NONE*/)
 {
 	if (NewData.Num() != 0)
 	{
+		if (SocketSubsystem && SocketSubsystem->IsCapturingPackets())
+		{
+			SocketSubsystem->RecordPacket(EPlayFabPacketDirection::Incoming, static_cast<uint16>(GetPortNo()), SourceEndpoint, NewData.GetData(), NewData.Num());
+		}
+
 		// Remove oldest packet if we are full up
 		if (PendingPackets.IsFull())
 		{
 			PendingPackets.Dequeue();
 		}
 
-		PendingPackets.Enqueue(PartyPacket(SourceEndpoint, NewData));
+		PendingPackets.Enqueue(PartyPacket(SourceEndpoint, NewData, SourcePort == INDEX_NONE ? SourceEndpoint : SourcePort));
 	}
 }
\ No newline at end of file
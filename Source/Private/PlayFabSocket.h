@@ -14,15 +14,37 @@ struct PartyPacket
 {
 	PartyPacket() = default;
 
-	PartyPacket(uint16 InSourceEndpoint, const TArray<uint8>& InData) :
+	PartyPacket(uint16 InSourceEndpoint, const TArray<uint8>& InData, int32 InSourcePort) :
 		SourceEndpoint(InSourceEndpoint),
+		SourcePort(InSourcePort),
 		Data(InData)
 	{}
 
 	uint16 SourceEndpoint = 0;
+	// Party traffic uses the endpoint id, loopback traffic the sending socket's loopback port so replies reach that socket
+	int32 SourcePort = 0;
 	TArray<uint8> Data;
 };
 
+// Send path traffic classes, each mapped to its own Party queuing priority and timeout
+enum class EPlayFabTrafficClass : uint8
+{
+	Control,		// Handshake, connection setup and ack-sized packets
+	Interactive,	// Regular gameplay packets (RPCs, small replication updates)
+	Bulk,			// Packets filled close to MaxPacket by actor replication
+	Count
+};
+
+const TCHAR* LexToString(EPlayFabTrafficClass TrafficClass);
+
+struct FPlayFabTrafficClassSettings
+{
+	int8 Priority = Party::c_maxSendMessageQueuingPriority;
+	uint32 TimeoutInMilliseconds = 0;
+	uint64 SentMessages = 0;
+	uint64 SentBytes = 0;
+};
+
 class FPlayFabSocket : public FSocket
 {
 PACKAGE_SCOPE:
@@ -36,6 +58,14 @@ PACKAGE_SCOPE:
 
 	TCircularQueue<PartyPacket> PendingPackets;
 
+	// Assigned by FPlayFabSocketSubsystem::AddSocket, addresses this socket on the in-process loopback route
+	int32 LoopbackPort = 0;
+
+	// Loopback counters for traffic between sockets sharing the local endpoint, which never reaches Party
+	uint64 LoopbackPacketsSent = 0;
+	uint64 LoopbackBytesSent = 0;
+	uint64 LoopbackPacketsReceived = 0;
+
 public:
 	// FSocket implementation
 	FPlayFabSocket(FOnlineSubsystemPlayFab* InOSSPlayFab, const FString& InSocketDescription, const FName& InSocketProtocol);
@@ -81,12 +111,30 @@ public:
 	virtual bool SetReceiveBufferSize(int32 Size, int32& NewSize) override { return true; }
 
 
-	void AddNewPendingData(uint16 sourceEndpoint, TArray<uint8> NewData);
+	// SourcePort defaults to the endpoint id, the port Party traffic is addressed with
+	void AddNewPendingData(uint16 SourceEndpoint, TArray<uint8> NewData, int32 SourcePort = INDEX_NONE);
+
+	// Traffic class applied to the next SendTo calls, set by UPlayFabNetConnection around its sends
+	void SetTrafficClass(EPlayFabTrafficClass InTrafficClass) { CurrentTrafficClass = InTrafficClass; }
+	bool IsTrafficClassificationEnabled() const { return bTrafficClassificationEnabled; }
+	const FPlayFabTrafficClassSettings& GetTrafficClassSettings(EPlayFabTrafficClass TrafficClass) const { return TrafficClasses[static_cast<int32>(TrafficClass)]; }
 
 private:
+	void LoadTrafficClassConfig();
+	bool SendToLoopback(const uint8* Data, int32 Count, int32& BytesSent, uint16 LocalEndpointId, int32 DestinationPort);
+	bool GetLocalEndpointId(uint16& OutEndpointId);
+
+	// Party only assigns the id once the endpoint is created, so it is cached on the first successful query
+	uint16 CachedLocalEndpointId = 0;
+	bool bHasCachedLocalEndpointId = false;
+
 	// Party instance send message mode
 	Party::PartySendMessageOptions PlayFabPartySendMode = Party::PartySendMessageOptions::Default;
 
 	// Party queuing configuration
 	Party::PartySendMessageQueuingConfiguration PartyQueueConfiguration = {};
+
+	bool bTrafficClassificationEnabled = false;
+	EPlayFabTrafficClass CurrentTrafficClass = EPlayFabTrafficClass::Control;
+	FPlayFabTrafficClassSettings TrafficClasses[static_cast<int32>(EPlayFabTrafficClass::Count)];
 };
\ No newline at end of file
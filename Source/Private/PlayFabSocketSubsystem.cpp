@@ -8,6 +8,7 @@
 #include "SocketSubsystemModule.h"
 #include "PlayFabSocketSubsystem.h"
 #include "IPAddressPlayFab.h"
+#include "PlayFabPacketCapture.h"
 
 FPlayFabSocketSubsystem* FPlayFabSocketSubsystem::SocketSingleton = nullptr;
 
@@ -48,6 +49,26 @@ void DestroyPlayFabSocketSubsystem()
 
 FPlayFabSocketSubsystem::FPlayFabSocketSubsystem()
 {
+	LoadLoopbackSimulationSettings();
+}
+
+void FPlayFabSocketSubsystem::LoadLoopbackSimulationSettings()
+{
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("LoopbackSimulatedLatencyMs"), LoopbackSimulation.LatencyInMilliseconds, GEngineIni);
+	GConfig->GetFloat(TEXT("OnlineSubsystemPlayFab"), TEXT("LoopbackSimulatedLossPercentage"), LoopbackSimulation.LossPercentage, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("LoopbackSimulatedBandwidthBytesPerSecond"), LoopbackSimulation.BandwidthInBytesPerSecond, GEngineIni);
+	GConfig->GetInt(TEXT("OnlineSubsystemPlayFab"), TEXT("LoopbackSimulationRandomSeed"), LoopbackSimulation.RandomSeed, GEngineIni);
+
+	LoopbackSimulation.LatencyInMilliseconds = FMath::Max(LoopbackSimulation.LatencyInMilliseconds, 0);
+	LoopbackSimulation.LossPercentage = FMath::Clamp(LoopbackSimulation.LossPercentage, 0.0f, 100.0f);
+	LoopbackSimulation.BandwidthInBytesPerSecond = FMath::Max(LoopbackSimulation.BandwidthInBytesPerSecond, 0);
+	LoopbackLossRandomStream.Initialize(LoopbackSimulation.RandomSeed);
+
+	if (LoopbackSimulation.IsEnabled())
+	{
+		UE_LOG(LogSockets, Log, TEXT("FPlayFabSocketSubsystem: Loopback simulation latency %dms loss %.1f%% bandwidth %d bytes/s seed %d"),
+			LoopbackSimulation.LatencyInMilliseconds, LoopbackSimulation.LossPercentage, LoopbackSimulation.BandwidthInBytesPerSecond, LoopbackSimulation.RandomSeed);
+	}
 }
 
 FPlayFabSocketSubsystem* FPlayFabSocketSubsystem::Create()
@@ -112,6 +133,15 @@ void FPlayFabSocketSubsystem::Shutdown()
 {
 	UE_LOG(LogSockets, Log, TEXT("FPlayFabSocketSubsystem: Shutting down"));
 
+	StopPacketCapture();
+	PacketReplay.Reset();
+	DelayedLoopbackPackets.Empty();
+
+	if (LoopbackSimulatedDrops > 0)
+	{
+		UE_LOG(LogSockets, Log, TEXT("FPlayFabSocketSubsystem: Loopback simulation dropped %llu packets"), LoopbackSimulatedDrops);
+	}
+
 	CleanUpActiveSockets();
 
 	// Clean up our delegates here
@@ -239,6 +269,7 @@ void FPlayFabSocketSubsystem::AddSocket(FPlayFabSocket* NewSocket)
 
 	if (NewSocket)
 	{
+		NewSocket->LoopbackPort = NextLoopbackPort++;
 		ActiveSockets.Add(NewSocket);
 	}
 	else
@@ -252,6 +283,246 @@ void FPlayFabSocketSubsystem::RemoveSocket(FPlayFabSocket* Socket)
 	UE_LOG(LogSockets, Verbose, TEXT("FPlayFabSocketSubsystem::RemoveSocket"));
 
 	ActiveSockets.RemoveSingleSwap(Socket);
+
+	// Delayed packets keep a pointer to their destination socket, which must not outlive the socket
+	const int32 PurgedCount = DelayedLoopbackPackets.RemoveAll([Socket](const FPlayFabDelayedLoopbackPacket& DelayedPacket) { return DelayedPacket.DestinationSocket == Socket; });
+	if (PurgedCount > 0)
+	{
+		UE_LOG(LogSockets, Verbose, TEXT("FPlayFabSocketSubsystem::RemoveSocket: Dropped %d delayed loopback packets addressed to the removed socket"), PurgedCount);
+	}
+}
+
+FPlayFabSocket* FPlayFabSocketSubsystem::FindLoopbackDestination(const FPlayFabSocket* SourceSocket, int32 DestinationPort)
+{
+	if (IsLoopbackPort(DestinationPort))
+	{
+		for (FPlayFabSocket* Socket : ActiveSockets)
+		{
+			if (Socket && Socket != SourceSocket && Socket->LoopbackPort == DestinationPort)
+			{
+				return Socket;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// An endpoint id address (e.g. the connect URL of the host) only names a socket when exactly one other socket exists,
+	// replies then come back from its loopback port
+	FPlayFabSocket* OnlyOtherSocket = nullptr;
+	for (FPlayFabSocket* Socket : ActiveSockets)
+	{
+		if (Socket && Socket != SourceSocket)
+		{
+			if (OnlyOtherSocket != nullptr)
+			{
+				if (!bLoggedAmbiguousLoopbackDestination)
+				{
+					UE_LOG(LogSockets, Warning, TEXT("FPlayFabSocketSubsystem: Dropping loopback packets addressed to port %d, several sockets share the local endpoint and none owns that port"), DestinationPort);
+					bLoggedAmbiguousLoopbackDestination = true;
+				}
+				return nullptr;
+			}
+			OnlyOtherSocket = Socket;
+		}
+	}
+
+	return OnlyOtherSocket;
+}
+
+bool FPlayFabSocketSubsystem::DeliverLoopbackPacket(const FPlayFabSocket* SourceSocket, uint16 SourceEndpointId, int32 DestinationPort, const uint8* Data, int32 Count)
+{
+	FPlayFabSocket* DestinationSocket = FindLoopbackDestination(SourceSocket, DestinationPort);
+	if (DestinationSocket == nullptr)
+	{
+		return false;
+	}
+
+	const int32 SourcePort = SourceSocket ? SourceSocket->LoopbackPort : 0;
+
+	if (!LoopbackSimulation.IsEnabled())
+	{
+		DeliverLoopbackPacketNow(DestinationSocket, SourceEndpointId, SourcePort, Data, Count);
+		return true;
+	}
+
+	// A lost packet still counts as sent, like it would on a real link
+	if (LoopbackSimulation.LossPercentage > 0.0f && LoopbackLossRandomStream.FRand() * 100.0f < LoopbackSimulation.LossPercentage)
+	{
+		LoopbackSimulatedDrops++;
+		return true;
+	}
+
+	// Packets serialize onto the link one after another, then all take the same propagation latency
+	const double Now = FPlatformTime::Seconds();
+	const double SerializationTime = LoopbackSimulation.BandwidthInBytesPerSecond > 0 ? static_cast<double>(Count) / LoopbackSimulation.BandwidthInBytesPerSecond : 0.0;
+	LoopbackLinkBusyUntil = FMath::Max(Now, LoopbackLinkBusyUntil) + SerializationTime;
+
+	FPlayFabDelayedLoopbackPacket& DelayedPacket = DelayedLoopbackPackets.AddDefaulted_GetRef();
+	DelayedPacket.DeliveryTime = LoopbackLinkBusyUntil + LoopbackSimulation.LatencyInMilliseconds / 1000.0;
+	DelayedPacket.DestinationSocket = DestinationSocket;
+	DelayedPacket.SourceEndpointId = SourceEndpointId;
+	DelayedPacket.SourcePort = SourcePort;
+	DelayedPacket.Data.Append(Data, Count);
+
+	return true;
+}
+
+void FPlayFabSocketSubsystem::FlushDelayedLoopbackPackets()
+{
+	// Delivery times are monotonic, so everything due is at the front
+	const double Now = FPlatformTime::Seconds();
+	int32 DueCount = 0;
+	while (DueCount < DelayedLoopbackPackets.Num() && DelayedLoopbackPackets[DueCount].DeliveryTime <= Now)
+	{
+		const FPlayFabDelayedLoopbackPacket& DelayedPacket = DelayedLoopbackPackets[DueCount];
+		DeliverLoopbackPacketNow(DelayedPacket.DestinationSocket, DelayedPacket.SourceEndpointId, DelayedPacket.SourcePort, DelayedPacket.Data.GetData(), DelayedPacket.Data.Num());
+		++DueCount;
+	}
+
+	if (DueCount > 0)
+	{
+		DelayedLoopbackPackets.RemoveAt(0, DueCount, false);
+	}
+}
+
+void FPlayFabSocketSubsystem::DeliverLoopbackPacketNow(FPlayFabSocket* DestinationSocket, uint16 SourceEndpointId, int32 SourcePort, const uint8* Data, int32 Count)
+{
+	DestinationSocket->AddNewPendingData(SourceEndpointId, TArray<uint8>(Data, Count), SourcePort);
+	DestinationSocket->LoopbackPacketsReceived++;
+}
+
+bool FPlayFabSocketSubsystem::RunLoopbackCheck(FOutputDevice& Ar)
+{
+	if (OSSPlayFab == nullptr)
+	{
+		Ar.Logf(TEXT("FPlayFabSocketSubsystem::RunLoopbackCheck: PlayFab online subsystem is not available"));
+		return false;
+	}
+
+	if (LoopbackSimulation.IsEnabled())
+	{
+		Ar.Logf(TEXT("FPlayFabSocketSubsystem::RunLoopbackCheck: Disable the loopback simulation before running the check"));
+		return false;
+	}
+
+	// A host and two clients, addressed by loopback port so the check runs with or without a Party network
+	FPlayFabSocket* HostSocket = static_cast<FPlayFabSocket*>(CreateSocket(NAME_DGram, TEXT("PlayFabLoopbackCheckHost"), FNetworkProtocolTypes::PlayFab));
+	FPlayFabSocket* ClientSocket = static_cast<FPlayFabSocket*>(CreateSocket(NAME_DGram, TEXT("PlayFabLoopbackCheckClient"), FNetworkProtocolTypes::PlayFab));
+	FPlayFabSocket* BystanderSocket = static_cast<FPlayFabSocket*>(CreateSocket(NAME_DGram, TEXT("PlayFabLoopbackCheckBystander"), FNetworkProtocolTypes::PlayFab));
+
+	bool bPassed = HostSocket && ClientSocket && BystanderSocket;
+	if (bPassed)
+	{
+		const uint8 Request[] = { 'p', 'i', 'n', 'g' };
+		const uint8 Response[] = { 'p', 'o', 'n', 'g' };
+		uint8 ReceiveBuffer[16];
+		int32 BytesSent = 0;
+		int32 BytesRead = 0;
+		uint32 PendingDataSize = 0;
+
+		// Client to host, which must reach the host only and report the client's port as source
+		FInternetAddrPlayFab HostAddr;
+		HostAddr.SetPort(HostSocket->LoopbackPort);
+		FInternetAddrPlayFab ClientSourceAddr;
+		bPassed &= ClientSocket->SendTo(Request, sizeof(Request), BytesSent, HostAddr) && BytesSent == sizeof(Request);
+		bPassed &= !BystanderSocket->HasPendingData(PendingDataSize);
+		bPassed &= HostSocket->RecvFrom(ReceiveBuffer, sizeof(ReceiveBuffer), BytesRead, ClientSourceAddr) && BytesRead == sizeof(Request) && FMemory::Memcmp(ReceiveBuffer, Request, sizeof(Request)) == 0;
+		bPassed &= ClientSourceAddr.GetPort() == ClientSocket->LoopbackPort;
+
+		// Host replies to the address it received from
+		FInternetAddrPlayFab HostSourceAddr;
+		bPassed &= HostSocket->SendTo(Response, sizeof(Response), BytesSent, ClientSourceAddr) && BytesSent == sizeof(Response);
+		bPassed &= !BystanderSocket->HasPendingData(PendingDataSize);
+		bPassed &= ClientSocket->RecvFrom(ReceiveBuffer, sizeof(ReceiveBuffer), BytesRead, HostSourceAddr) && BytesRead == sizeof(Response) && FMemory::Memcmp(ReceiveBuffer, Response, sizeof(Response)) == 0;
+		bPassed &= HostSourceAddr.GetPort() == HostSocket->LoopbackPort;
+
+		bPassed &= HostSocket->LoopbackPacketsSent == 1 && HostSocket->LoopbackPacketsReceived == 1;
+		bPassed &= ClientSocket->LoopbackPacketsSent == 1 && ClientSocket->LoopbackPacketsReceived == 1;
+		bPassed &= BystanderSocket->LoopbackPacketsReceived == 0;
+	}
+
+	DestroySocket(HostSocket);
+	DestroySocket(ClientSocket);
+	DestroySocket(BystanderSocket);
+
+	Ar.Logf(TEXT("Loopback check %s"), bPassed ? TEXT("passed") : TEXT("failed"));
+	return bPassed;
+}
+
+bool FPlayFabSocketSubsystem::StartPacketCapture(const FString& Filename)
+{
+	TSharedPtr<FPlayFabPacketCapture> NewCapture = MakeShared<FPlayFabPacketCapture>();
+	if (!NewCapture->Start(Filename))
+	{
+		return false;
+	}
+
+	PacketCapture = NewCapture;
+	return true;
+}
+
+void FPlayFabSocketSubsystem::StopPacketCapture()
+{
+	if (PacketCapture.IsValid())
+	{
+		PacketCapture->Stop();
+		PacketCapture.Reset();
+	}
+}
+
+bool FPlayFabSocketSubsystem::IsConnectedToPartyNetwork() const
+{
+	return OSSPlayFab && (OSSPlayFab->Network != nullptr || OSSPlayFab->LocalEndpoint != nullptr);
+}
+
+bool FPlayFabSocketSubsystem::StartPacketReplay(const FString& Filename)
+{
+	// Captured endpoint ids may belong to real peers in a live network, so replayed packets would corrupt their connections
+	if (IsConnectedToPartyNetwork())
+	{
+		UE_LOG(LogSockets, Warning, TEXT("FPlayFabSocketSubsystem::StartPacketReplay: Refusing to replay %s while connected to a Party network"), *Filename);
+		return false;
+	}
+
+	TSharedPtr<FPlayFabPacketReplay> NewReplay = MakeShared<FPlayFabPacketReplay>();
+	if (!NewReplay->Load(Filename))
+	{
+		return false;
+	}
+
+	PacketReplay = NewReplay;
+	return true;
+}
+
+void FPlayFabSocketSubsystem::Tick(float DeltaTime)
+{
+	if (DelayedLoopbackPackets.Num() > 0)
+	{
+		FlushDelayedLoopbackPackets();
+	}
+
+	if (PacketReplay.IsValid())
+	{
+		if (IsConnectedToPartyNetwork())
+		{
+			UE_LOG(LogSockets, Warning, TEXT("FPlayFabSocketSubsystem: Stopping packet replay, a Party network was joined"));
+			PacketReplay.Reset();
+		}
+		else if (!PacketReplay->Tick(DeltaTime, GetSocket()))
+		{
+			PacketReplay.Reset();
+		}
+	}
+}
+
+void FPlayFabSocketSubsystem::RecordPacket(EPlayFabPacketDirection Direction, uint16 LocalEndpointId, uint16 RemoteEndpointId, const uint8* Data, int32 Count)
+{
+	// Don't record packets we are feeding in from a replay
+	if (PacketCapture.IsValid() && !(PacketReplay.IsValid() && Direction == EPlayFabPacketDirection::Incoming))
+	{
+		PacketCapture->RecordPacket(Direction, LocalEndpointId, RemoteEndpointId, Data, Count);
+	}
 }
 
 void FPlayFabSocketSubsystem::CleanUpActiveSockets()
@@ -0,0 +1,187 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PlayFabStateChangeTrace.h"
+#include "OnlineSubsystemPlayFab.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Serialization/Archive.h"
+
+const uint32 FPlayFabStateChangeTrace::FileMagic = 0x54534650; // "PFST"
+const uint32 FPlayFabStateChangeTrace::FileVersion = 1;
+const uint8 FPlayFabStateChangeTrace::BatchRecordFlag = 0x80;
+
+FPlayFabStateChangeTrace::~FPlayFabStateChangeTrace()
+{
+	Stop();
+}
+
+FString FPlayFabStateChangeTrace::GetDefaultFilename()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("PlayFab"), FString::Printf(TEXT("StateChangeTrace_%s.pfst"), *FDateTime::Now().ToString()));
+}
+
+bool FPlayFabStateChangeTrace::Start(const FString& InFilename)
+{
+	Stop();
+
+	Filename = InFilename.IsEmpty() ? GetDefaultFilename() : InFilename;
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Writer.IsValid())
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabStateChangeTrace::Start: Failed to open %s for writing"), *Filename);
+		return false;
+	}
+
+	uint32 Magic = FileMagic;
+	uint32 Version = FileVersion;
+	int64 StartTicks = FDateTime::UtcNow().GetTicks();
+	*Writer << Magic;
+	*Writer << Version;
+	*Writer << StartTicks;
+
+	LastRecordTime = FPlatformTime::Seconds();
+	RecordedStateChanges = 0;
+
+	UE_LOG_ONLINE(Log, TEXT("FPlayFabStateChangeTrace: Tracing state changes to %s"), *Filename);
+	return true;
+}
+
+void FPlayFabStateChangeTrace::Stop()
+{
+	if (Writer.IsValid())
+	{
+		Writer->Close();
+		Writer.Reset();
+
+		UE_LOG_ONLINE(Log, TEXT("FPlayFabStateChangeTrace: Traced %llu state changes to %s"), RecordedStateChanges, *Filename);
+	}
+}
+
+void FPlayFabStateChangeTrace::RecordStateChange(EPlayFabStateChangeSource Source, uint32 StateChangeType, uint64 HandlerCycles)
+{
+	if (Writer.IsValid())
+	{
+		WriteRecord(static_cast<uint8>(Source), StateChangeType, HandlerCycles);
+		RecordedStateChanges++;
+	}
+}
+
+void FPlayFabStateChangeTrace::RecordBatch(EPlayFabStateChangeSource Source, uint32 StateChangeCount, uint64 BatchCycles)
+{
+	if (Writer.IsValid() && StateChangeCount > 0)
+	{
+		WriteRecord(static_cast<uint8>(Source) | BatchRecordFlag, StateChangeCount, BatchCycles);
+	}
+}
+
+void FPlayFabStateChangeTrace::WriteRecord(uint8 SourceValue, uint32 Type, uint64 Cycles)
+{
+	const double Now = FPlatformTime::Seconds();
+	uint32 DeltaMicroseconds = static_cast<uint32>(FMath::Clamp((Now - LastRecordTime) * 1000000.0, 0.0, static_cast<double>(MAX_uint32)));
+	uint32 Nanoseconds = static_cast<uint32>(FMath::Clamp(FPlatformTime::ToSeconds64(Cycles) * 1000000000.0, 0.0, static_cast<double>(MAX_uint32)));
+	LastRecordTime = Now;
+
+	*Writer << SourceValue;
+	Writer->SerializeIntPacked(DeltaMicroseconds);
+	Writer->SerializeIntPacked(Type);
+	Writer->SerializeIntPacked(Nanoseconds);
+}
+
+TSharedPtr<FJsonObject> FPlayFabStateChangeTrace::BuildReport(const FString& InFilename)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*InFilename));
+	if (!Reader.IsValid())
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabStateChangeTrace::BuildReport: Failed to open %s"), *InFilename);
+		return nullptr;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int64 StartTicks = 0;
+	*Reader << Magic;
+	*Reader << Version;
+	*Reader << StartTicks;
+	if (Magic != FileMagic || Version != FileVersion)
+	{
+		UE_LOG_ONLINE(Warning, TEXT("FPlayFabStateChangeTrace::BuildReport: %s is not a supported state change trace (magic 0x%08x version %u)"), *InFilename, Magic, Version);
+		return nullptr;
+	}
+
+	struct FHandlerCost
+	{
+		uint32 Count = 0;
+		uint64 TotalNanoseconds = 0;
+		uint32 MaxNanoseconds = 0;
+		double MaxAtSeconds = 0.0;
+	};
+
+	// Keyed by (source << 32 | type), batch summaries use the source alone with the batch flag set
+	TMap<uint64, FHandlerCost> Costs;
+	double Timestamp = 0.0;
+	while (!Reader->AtEnd() && !Reader->IsError())
+	{
+		uint8 SourceValue = 0;
+		uint32 DeltaMicroseconds = 0;
+		uint32 Type = 0;
+		uint32 Nanoseconds = 0;
+
+		*Reader << SourceValue;
+		Reader->SerializeIntPacked(DeltaMicroseconds);
+		Reader->SerializeIntPacked(Type);
+		Reader->SerializeIntPacked(Nanoseconds);
+		if (Reader->IsError())
+		{
+			UE_LOG_ONLINE(Warning, TEXT("FPlayFabStateChangeTrace::BuildReport: %s is truncated"), *InFilename);
+			break;
+		}
+
+		Timestamp += DeltaMicroseconds / 1000000.0;
+
+		const bool bBatch = (SourceValue & BatchRecordFlag) != 0;
+		const uint64 Key = (static_cast<uint64>(SourceValue) << 32) | (bBatch ? 0 : Type);
+		FHandlerCost& Cost = Costs.FindOrAdd(Key);
+		Cost.Count += bBatch ? Type : 1;
+		Cost.TotalNanoseconds += Nanoseconds;
+		if (Nanoseconds > Cost.MaxNanoseconds)
+		{
+			Cost.MaxNanoseconds = Nanoseconds;
+			Cost.MaxAtSeconds = Timestamp;
+		}
+	}
+
+	TSharedPtr<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("Trace"), InFilename);
+	Report->SetStringField(TEXT("Recorded"), FDateTime(StartTicks).ToIso8601());
+	Report->SetNumberField(TEXT("DurationSeconds"), Timestamp);
+
+	TArray<TSharedPtr<FJsonValue>> Handlers;
+	TArray<TSharedPtr<FJsonValue>> Batches;
+	for (const TPair<uint64, FHandlerCost>& Entry : Costs)
+	{
+		const uint8 SourceValue = static_cast<uint8>(Entry.Key >> 32);
+		const bool bBatch = (SourceValue & BatchRecordFlag) != 0;
+		const EPlayFabStateChangeSource Source = static_cast<EPlayFabStateChangeSource>(SourceValue & ~BatchRecordFlag);
+		const FHandlerCost& Cost = Entry.Value;
+
+		TSharedPtr<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetStringField(TEXT("Source"), Source == EPlayFabStateChangeSource::Party ? TEXT("Party") : TEXT("Lobby"));
+		if (!bBatch)
+		{
+			Object->SetNumberField(TEXT("StateChangeType"), static_cast<uint32>(Entry.Key));
+		}
+		Object->SetNumberField(TEXT("StateChanges"), Cost.Count);
+		Object->SetNumberField(TEXT("TotalUs"), Cost.TotalNanoseconds / 1000.0);
+		Object->SetNumberField(TEXT("MaxUs"), Cost.MaxNanoseconds / 1000.0);
+		Object->SetNumberField(TEXT("MaxAtSeconds"), Cost.MaxAtSeconds);
+		(bBatch ? Batches : Handlers).Add(MakeShared<FJsonValueObject>(Object));
+	}
+	Report->SetArrayField(TEXT("Handlers"), Handlers);
+	Report->SetArrayField(TEXT("Batches"), Batches);
+
+	return Report;
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+class FArchive;
+
+enum class EPlayFabStateChangeSource : uint8
+{
+	Party,	// PartyManager::StartProcessingStateChanges
+	Lobby	// PFMultiplayerStartProcessingLobbyStateChanges
+};
+
+/**
+ * Records every state change dispatched by FOnlineSubsystemPlayFab::DoWork and FPlayFabLobby::DoWork
+ * together with the time its handler took, so handler cost can be analysed offline:
+ *   header:  uint32 magic, uint32 version, int64 trace start (UTC ticks)
+ *   records: uint8 source (high bit set for a batch summary), packed uint32 microseconds since previous record,
+ *            packed uint32 state change type (or batch size), packed uint32 handler (or whole batch) nanoseconds
+ */
+class FPlayFabStateChangeTrace
+{
+public:
+	~FPlayFabStateChangeTrace();
+
+	bool Start(const FString& InFilename);
+	void Stop();
+	bool IsRecording() const { return Writer.IsValid(); }
+
+	void RecordStateChange(EPlayFabStateChangeSource Source, uint32 StateChangeType, uint64 HandlerCycles);
+	void RecordBatch(EPlayFabStateChangeSource Source, uint32 StateChangeCount, uint64 BatchCycles);
+
+	static FString GetDefaultFilename();
+
+	// Aggregates a recorded trace per source and state change type, returns null if the file cannot be read
+	static TSharedPtr<FJsonObject> BuildReport(const FString& InFilename);
+
+private:
+	void WriteRecord(uint8 SourceValue, uint32 Type, uint64 Cycles);
+
+	static const uint32 FileMagic;
+	static const uint32 FileVersion;
+	static const uint8 BatchRecordFlag;
+
+	TUniquePtr<FArchive> Writer;
+	FString Filename;
+	double LastRecordTime = 0.0;
+	uint64 RecordedStateChanges = 0;
+};
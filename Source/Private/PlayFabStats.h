@@ -0,0 +1,17 @@
+//--------------------------------------------------------------------------------------
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("PlayFab"), STATGROUP_PlayFab, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Party DoWork"), STAT_PlayFab_PartyDoWork, STATGROUP_PlayFab, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Socket Tick"), STAT_PlayFab_SocketTick, STATGROUP_PlayFab, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Voice Tick"), STAT_PlayFab_VoiceTick, STATGROUP_PlayFab, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Session Tick"), STAT_PlayFab_SessionTick, STATGROUP_PlayFab, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Lobby DoWork"), STAT_PlayFab_LobbyDoWork, STATGROUP_PlayFab, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Matchmaking DoWork"), STAT_PlayFab_MatchmakingDoWork, STATGROUP_PlayFab, );
@@ -36,6 +36,11 @@ typedef TSharedPtr<class FOnlineCognitiveServicesPlayFab, ESPMode::ThreadSafe> F
 typedef TSharedPtr<class FPlayFabLobby, ESPMode::ThreadSafe> FPlayFabLobbyPtr;
 typedef TSharedPtr<class FMatchmakingInterfacePlayFab, ESPMode::ThreadSafe> FMatchmakingInterfacePtr;
 
+class FPlayFabTickProfiler;
+class FPlayFabStateChangeTrace;
+class FPlayFabJoinTimeline;
+class FPlayFabRegionLatencyCache;
+
 DECLARE_MULTICAST_DELEGATE_OneParam(FOnEndpointMessageReceived, const PartyEndpointMessageReceivedStateChange* /*Change*/);
 typedef FOnEndpointMessageReceived::FDelegate FOnEndpointMessageReceivedDelegate;
 
@@ -83,6 +88,14 @@ PACKAGE_SCOPE:
 		}
 	}
 
+	// Null unless PLAYFAB BENCHMARK TICKS START has been used
+	FPlayFabTickProfiler* GetTickProfiler() const { return TickProfiler.Get(); }
+
+	// Null unless a state change trace has been started
+	FPlayFabStateChangeTrace* GetStateChangeTrace() const { return StateChangeTrace.Get(); }
+
+	FPlayFabJoinTimeline* GetJoinTimeline() const { return JoinTimeline.Get(); }
+
 #ifdef OSS_PLAYFAB_PLAYSTATION
 	FOnlineAsyncTaskManagerPlayFab* GetAsyncTaskManager() { return OnlineAsyncTaskThreadRunnable; }
 	FRunnableThread* OnlineAsyncTaskThread;
@@ -158,6 +171,17 @@ public:
 	bool ConnectToPlayFabPartyNetwork(const FString& NetworkId, const FString& NetworkDescriptorStr);
 	void LeavePlayFabPartyNetwork();
 
+	// Opt-in (bEnablePartyNetworkPrewarm): creates the network a host would need while a matchmaking ticket is still queued.
+	// Every queued player allocates a relay, but only the lobby owner uses it; the others' relays stay allocated by Party
+	// for up to 10 minutes with nobody connected, so enable this only where the extra relays are acceptable.
+	void PrewarmPlayFabPartyNetwork();
+	void DiscardPrewarmedPlayFabPartyNetwork(const TCHAR* Reason);
+	// Discards the prewarmed network only when a matchmaking ticket created it, leaving a warm pool network in place
+	void DiscardMatchmakingPrewarmedPlayFabPartyNetwork(const TCHAR* Reason);
+
+	// Round trip time to each Party region, from the region latency cache when it is fresh or else the latest Party measurements
+	bool GetRegionRoundTripTimes(TMap<FString, uint32>& OutRoundTripMs) const;
+
 	IOnlineSubsystem* NativeOSS = nullptr;
 
 	bool bNetworkInitialized = false;
@@ -210,6 +234,7 @@ private:
 	
 	void DoWork();
 
+	bool InternalCreateNetwork(PartyLocalUser* PlayFabPartyLocalUser, const FString& InNetworkId, Party::PartyNetworkDescriptor& OutNetworkDescriptor, void* AsyncIdentifier);
 	bool InternalConnectToNetwork(PartyLocalUser* PlayFabPartyLocalUser, const FString& InNetworkId, Party::PartyNetworkDescriptor& NetworkDescriptor);
 
 	FOnlineIdentityPlayFabPtr IdentityInterface;
@@ -220,6 +245,46 @@ private:
 	FPlayFabLobbyPtr PlayFabLobbyInterface;
 	FMatchmakingInterfacePtr MatchmakingInterface;
 	TUniquePtr<PlayFabEventTracer> EventTracer;
+	TSharedPtr<FPlayFabTickProfiler> TickProfiler;
+	TSharedPtr<FPlayFabStateChangeTrace> StateChangeTrace;
+	TSharedPtr<FPlayFabJoinTimeline> JoinTimeline;
+	TSharedPtr<FPlayFabRegionLatencyCache> RegionLatencyCache;
+	double NetworkCreateStartTime = 0.0;
+	bool bNetworkCreateUsedCachedRegions = false;
+
+	struct FPrewarmedPartyNetwork
+	{
+		FString NetworkId;
+		PartyNetworkDescriptor NetworkDescriptor = {};
+		double StartTime = 0.0;
+		double ReadyTime = 0.0;
+		// Passed as the creation async identifier, so a late completion for an earlier prewarm is not mistaken for this one
+		uint64 Generation = 0;
+		bool bFromWarmPool = false;
+		bool bValid = false;
+	};
+	FPrewarmedPartyNetwork PrewarmedNetwork;
+	uint64 NextPrewarmGeneration = 1;
+	bool bEnablePartyNetworkPrewarm = false;
+	float PartyNetworkPrewarmMaxAge = 120.0f;
+	uint32 PrewarmedNetworksUsed = 0;
+	uint32 PrewarmedNetworksWasted = 0;
+	double PrewarmSecondsSaved = 0.0;
+
+	// Host warm pool: keeps a prewarmed network ready whenever no network is in use, so hosting skips network creation
+	bool bEnableHostNetworkWarmPool = false;
+	float HostNetworkWarmPoolRetryInterval = 10.0f;
+	// Networks the pool may create in any rolling hour, so an idle client does not create one every max age forever. 0 is unlimited
+	int32 HostNetworkWarmPoolMaxRefillsPerHour = 6;
+	TArray<double> HostNetworkWarmPoolRefillTimes;
+	double LastHostNetworkWarmPoolAttemptTime = 0.0;
+	uint32 HostNetworkWarmPoolHits = 0;
+	uint32 HostNetworkWarmPoolMisses = 0;
+	uint32 HostNetworkWarmPoolWasted = 0;
+	uint32 HostNetworkWarmPoolRefillsSkipped = 0;
+
+	bool InternalPrewarmNetwork(bool bFromWarmPool);
+	void MaintainHostNetworkWarmPool();
 
 	PFMultiplayerHandle MultiplayerHandle;
 
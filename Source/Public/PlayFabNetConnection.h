@@ -9,6 +9,8 @@
 #include "IpConnection.h"
 #include "PlayFabNetConnection.generated.h"
 
+enum class EPlayFabTrafficClass : uint8;
+
 UCLASS(transient, config = Engine)
 class UPlayFabNetConnection : public UIpConnection
 {
@@ -18,8 +20,40 @@ class UPlayFabNetConnection : public UIpConnection
 	virtual void InitRemoteConnection(class UNetDriver* InDriver, class FSocket* InSocket, const FURL& InURL, const class FInternetAddr& InRemoteAddr, EConnectionState InState, int32 InMaxPacket = 0, int32 InPacketOverhead = 0) override;
 	virtual void InitLocalConnection(class UNetDriver* InDriver, class FSocket* InSocket, const FURL& InURL, EConnectionState InState, int32 InMaxPacket = 0, int32 InPacketOverhead = 0) override;
 	virtual void FlushNet(bool bIgnoreSimulation = false) override;
+	virtual void LowLevelSend(void* Data, int32 CountBits, FOutPacketTraits& Traits) override;
+
+	// Samples the Party send queue for this connection's endpoint and adapts CurrentNetSpeed before Party starts timing out messages
+	void UpdateNetSpeedFromPartyStatistics(float DeltaTime);
 
 	bool bFallbackToPlatformSocketSubsystem = false;
 
+private:
+	void LoadNetSpeedAdaptationConfig();
+	void LoadTrafficClassConfig();
+
+	// Picks the EPlayFabTrafficClass for an outgoing packet of the given size
+	EPlayFabTrafficClass ClassifyOutgoingPacket(int32 PacketBytes) const;
+
+	// Traffic classification thresholds, read from [OnlineSubsystemPlayFab] in the engine ini
+	int32 TrafficClassControlMaxBytes = 32;
+	float TrafficClassBulkMinFraction = 0.75f;
+
+	// Net speed adaptation settings, read from [OnlineSubsystemPlayFab] in the engine ini
+	bool bNetSpeedAdaptationEnabled = false;
+	float NetSpeedAdaptationInterval = 0.25f;
+	int32 NetSpeedAdaptationQueuedBytesThreshold = 16384;
+	int32 NetSpeedAdaptationMinNetSpeed = 2600;
+	float NetSpeedAdaptationDecreaseFactor = 0.75f;
+	float NetSpeedAdaptationIncreaseFraction = 0.1f;
+
+	// Net speed adaptation state
+	float TimeSinceLastNetSpeedSample = 0.0f;
+	int32 NetSpeedCeiling = 0;
+	int32 LastAppliedNetSpeed = 0;
+	uint64 LastTimedOutSendMessages = 0;
+	uint64 LastTimedOutSendMessageBytes = 0;
+	uint32 NetSpeedDecreaseCount = 0;
+	uint32 NetSpeedIncreaseCount = 0;
+
 	friend class FSocketSubsystemPlayFab;
 };
\ No newline at end of file
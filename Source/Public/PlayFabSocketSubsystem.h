@@ -23,7 +23,32 @@ class FOnlineSubsystemPlayFab;
 #endif
 
 class FPlayFabSocket;
+class FPlayFabPacketCapture;
+class FPlayFabPacketReplay;
 class UPlayFabNetDriver;
+enum class EPlayFabPacketDirection : uint8;
+
+// Simulated link conditions applied to loopback traffic between sockets in this process. Only packets addressed by loopback port
+// skip the Party local endpoint, endpoint id addresses still need one
+struct FPlayFabLoopbackSimulationSettings
+{
+	int32 LatencyInMilliseconds = 0;
+	float LossPercentage = 0.0f;
+	int32 BandwidthInBytesPerSecond = 0;
+	// Seeds the loss decisions, so a run with the same seed and traffic drops the same packets
+	int32 RandomSeed = 0;
+
+	bool IsEnabled() const { return LatencyInMilliseconds > 0 || LossPercentage > 0.0f || BandwidthInBytesPerSecond > 0; }
+};
+
+struct FPlayFabDelayedLoopbackPacket
+{
+	double DeliveryTime = 0.0;
+	FPlayFabSocket* DestinationSocket = nullptr;
+	uint16 SourceEndpointId = 0;
+	int32 SourcePort = 0;
+	TArray<uint8> Data;
+};
 
 class FPlayFabSocketSubsystem : public ISocketSubsystem
 {
@@ -68,11 +93,31 @@ PACKAGE_SCOPE:
 
 	void RegisterDelegates(FOnlineSubsystemPlayFab* InOSSPlayFab);
 
+	// Drives delayed loopback delivery and packet replay, called from FOnlineSubsystemPlayFab::Tick
+	void Tick(float DeltaTime);
+
 	FPlayFabSocket* GetSocket();
 	void AddSocket(FPlayFabSocket* NewSocket);
 	void RemoveSocket(FPlayFabSocket* Socket);
 	void CleanUpActiveSockets();
 
+	// Hands a payload addressed to the local endpoint straight to the socket the destination port resolves to, returns false if none does
+	bool DeliverLoopbackPacket(const FPlayFabSocket* SourceSocket, uint16 SourceEndpointId, int32 DestinationPort, const uint8* Data, int32 Count);
+	// Loopback ports start above the uint16 endpoint id range, so they never collide with the endpoint id Party traffic uses as port
+	static bool IsLoopbackPort(int32 Port) { return Port >= LoopbackPortBase; }
+
+	// Sends between throwaway sockets on the loopback route and checks each packet reaches only the addressed socket, driven by PLAYFAB LOOPBACKCHECK
+	bool RunLoopbackCheck(FOutputDevice& Ar);
+
+	// Packet capture and injection of captured incoming packets into the live socket, driven by the PLAYFAB CAPTURE / PLAYFAB REPLAY console commands
+	bool StartPacketCapture(const FString& Filename);
+	void StopPacketCapture();
+	// Refused, and stopped, while connected to a Party network
+	bool StartPacketReplay(const FString& Filename);
+	bool IsConnectedToPartyNetwork() const;
+	void RecordPacket(EPlayFabPacketDirection Direction, uint16 LocalEndpointId, uint16 RemoteEndpointId, const uint8* Data, int32 Count);
+	bool IsCapturingPackets() const { return PacketCapture.IsValid(); }
+
 	// Singleton helpers
 	static FPlayFabSocketSubsystem* Create();
 	static void Destroy();
@@ -88,6 +133,24 @@ protected:
 
 	FDelegateHandle OnEndpointMessageReceivedDelegateHandle;
 
+	TSharedPtr<FPlayFabPacketCapture> PacketCapture;
+	TSharedPtr<FPlayFabPacketReplay> PacketReplay;
+
+	void LoadLoopbackSimulationSettings();
+	FPlayFabSocket* FindLoopbackDestination(const FPlayFabSocket* SourceSocket, int32 DestinationPort);
+	void DeliverLoopbackPacketNow(FPlayFabSocket* DestinationSocket, uint16 SourceEndpointId, int32 SourcePort, const uint8* Data, int32 Count);
+	void FlushDelayedLoopbackPackets();
+
+	static constexpr int32 LoopbackPortBase = 0x10000;
+	int32 NextLoopbackPort = LoopbackPortBase;
+	bool bLoggedAmbiguousLoopbackDestination = false;
+
+	FPlayFabLoopbackSimulationSettings LoopbackSimulation;
+	FRandomStream LoopbackLossRandomStream;
+	TArray<FPlayFabDelayedLoopbackPacket> DelayedLoopbackPackets;
+	double LoopbackLinkBusyUntil = 0.0;
+	uint64 LoopbackSimulatedDrops = 0;
+
 	FOnlineSubsystemPlayFab* OSSPlayFab = nullptr;
 
 	TWeakObjectPtr<UPlayFabNetDriver> NetDriver;